@@ -0,0 +1,255 @@
+// MIT License
+// 
+// Copyright(c) 2018 Alex Tversky
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#pragma once
+
+#include "Util/IAsyncPairWrittable.hpp"
+#include "Util/IPairWrittable.hpp"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Util
+{
+/**
+ *  \brief AsyncPairWrittable - IAsyncPairWrittable over any synchronous provider
+ *
+ *  \details For providers without native async support. Requests queue up
+ *           and a small worker pool serves them in batches: consecutive gets
+ *           go through one getValues() call, consecutive sets through one
+ *           setValues() call, so e.g. HiRedisProvider serves hundreds of
+ *           queued lookups with a single MGET round-trip. Callbacks run on
+ *           the pool threads. With more than one thread the provider must be
+ *           thread safe and requests may complete out of order.
+ */
+class AsyncPairWrittable : public IAsyncPairWrittable
+{
+  public:
+    using IAsyncPairWrittable::getValueAsync;
+    using IAsyncPairWrittable::setValueAsync;
+
+    explicit AsyncPairWrittable(IPairWrittable &provider, unsigned threads = 1, std::size_t maxBatch = 256);
+    virtual ~AsyncPairWrittable();
+
+    void getValueAsync(const std::string &key, GetCallback callback) override;
+    void setValueAsync(const std::string &key, const std::string &value, SetCallback callback) override;
+
+    std::size_t pending() const;
+
+  private:
+    AsyncPairWrittable(const AsyncPairWrittable &other) = delete;
+    AsyncPairWrittable(const AsyncPairWrittable &&other) = delete;
+    AsyncPairWrittable &operator=(const AsyncPairWrittable &other) = delete;
+    AsyncPairWrittable &operator=(const AsyncPairWrittable &&other) = delete;
+
+    struct Request
+    {
+        bool set;
+        std::string key;
+        std::string value;
+        GetCallback getCallback;
+        SetCallback setCallback;
+    };
+
+    void push(Request &request);
+    void work();
+    void serveGets(std::vector<Request> &batch);
+    void serveSets(std::vector<Request> &batch);
+
+  private:
+    IPairWrittable &provider_;
+    const std::size_t maxBatch_;
+    std::deque<Request> queue_;
+    bool running_;
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::vector<std::thread> threads_;
+};
+
+/**
+ * @brief Constructor
+ *
+ * @param provider - a synchronous provider, must outlive this object
+ * @param threads - number of pool threads, at least 1
+ * @param maxBatch - the most requests served by one provider call
+ */
+inline AsyncPairWrittable::AsyncPairWrittable(IPairWrittable &provider, unsigned threads, std::size_t maxBatch)
+    : provider_(provider), maxBatch_(maxBatch > 0 ? maxBatch : 1), running_(true)
+{
+    const unsigned count(threads > 0 ? threads : 1);
+    for (unsigned index = 0; index < count; ++index)
+    {
+        threads_.push_back(std::thread(&AsyncPairWrittable::work, this));
+    }
+}
+
+/**
+ * @brief Destructor, completes the queued requests first
+ */
+inline AsyncPairWrittable::~AsyncPairWrittable()
+{
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        running_ = false;
+    }
+    cv_.notify_all();
+    for (std::thread &thread : threads_)
+    {
+        if (thread.joinable())
+        {
+            thread.join();
+        }
+    }
+}
+
+/**
+ * @brief Queues a lookup of an exact key (no "\*" notation)
+ *
+ * @param [in] key - a key
+ * @param [in] callback - called with found and the value from a pool thread
+ */
+inline void AsyncPairWrittable::getValueAsync(const std::string &key, GetCallback callback)
+{
+    Request request;
+    request.set = false;
+    request.key = key;
+    request.getCallback = std::move(callback);
+    push(request);
+}
+
+/**
+ * @brief Queues setting a value for given key
+ *
+ * @param [in] callback - called with the status from a pool thread, may be empty
+ */
+inline void AsyncPairWrittable::setValueAsync(const std::string &key, const std::string &value,
+                                              SetCallback callback)
+{
+    Request request;
+    request.set = true;
+    request.key = key;
+    request.value = value;
+    request.setCallback = std::move(callback);
+    push(request);
+}
+
+/**
+ * @brief Returns number of queued requests not yet taken by a pool thread
+ */
+inline std::size_t AsyncPairWrittable::pending() const
+{
+    std::lock_guard<std::mutex> guard(mutex_);
+    return queue_.size();
+}
+
+inline void AsyncPairWrittable::push(Request &request)
+{
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        queue_.push_back(std::move(request));
+    }
+    cv_.notify_one();
+}
+
+inline void AsyncPairWrittable::work()
+{
+    std::vector<Request> batch;
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true)
+    {
+        cv_.wait(lock, [this]() { return !running_ || !queue_.empty(); });
+        if (queue_.empty())
+        {
+            break; // stopped and drained
+        }
+
+        // Take a run of requests of one kind, so sets and gets stay ordered
+        const bool set(queue_.front().set);
+        while (!queue_.empty() && queue_.front().set == set && batch.size() < maxBatch_)
+        {
+            batch.push_back(std::move(queue_.front()));
+            queue_.pop_front();
+        }
+
+        lock.unlock();
+        if (set)
+        {
+            serveSets(batch);
+        }
+        else
+        {
+            serveGets(batch);
+        }
+        batch.clear();
+        lock.lock();
+    }
+}
+
+inline void AsyncPairWrittable::serveGets(std::vector<Request> &batch)
+{
+    std::vector<std::string> keys;
+    std::vector<std::string> values;
+    keys.reserve(batch.size());
+    for (Request &request : batch)
+    {
+        keys.push_back(std::move(request.key));
+    }
+
+    provider_.getValues(keys, values);
+    for (std::size_t index = 0; index < batch.size(); ++index)
+    {
+        if (batch[index].getCallback)
+        {
+            const bool found(index < values.size() && !values[index].empty());
+            batch[index].getCallback(found, found ? values[index] : std::string());
+        }
+    }
+}
+
+inline void AsyncPairWrittable::serveSets(std::vector<Request> &batch)
+{
+    bool status(false);
+    if (batch.size() == 1)
+    {
+        status = provider_.setValue(batch[0].key, batch[0].value);
+    }
+    else
+    {
+        std::vector<KeyValuePair> pairs;
+        pairs.reserve(batch.size());
+        for (Request &request : batch)
+        {
+            pairs.push_back(KeyValuePair(std::move(request.key), std::move(request.value)));
+        }
+        status = provider_.setValues(pairs);
+    }
+
+    for (Request &request : batch)
+    {
+        if (request.setCallback)
+        {
+            request.setCallback(status);
+        }
+    }
+}
+}
@@ -0,0 +1,253 @@
+// MIT License
+// 
+// Copyright(c) 2018 Alex Tversky
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h> // POSIX only
+#include <unistd.h>
+
+namespace Util
+{
+/**
+ *  \brief BloomFilter - a compact set answering "maybe" or "certainly not"
+ *
+ *  \details Sized for an expected number of keys at a number of bits per
+ *           key: 10 bits per key give about 1% false positives. Positions
+ *           come from one 64-bit hash split in two (double hashing).
+ *           An empty filter, e.g. one not loaded, answers "maybe".
+ */
+class BloomFilter
+{
+  public:
+    explicit BloomFilter(std::size_t keys = 0, unsigned bitsPerKey = 10);
+    virtual ~BloomFilter();
+
+    void add(const char *key, std::size_t length);
+    bool mayContain(const char *key, std::size_t length) const;
+    std::size_t bitCount() const;
+
+    bool save(const std::string &path) const;
+    bool load(const std::string &path);
+
+  private:
+    static std::uint64_t hashOf(const char *key, std::size_t length);
+    static std::uint64_t checksumOf(const std::vector<std::uint64_t> &bits, std::uint64_t hashes);
+    static bool syncFile(const std::string &path, bool directory);
+
+  private:
+    std::vector<std::uint64_t> bits_;
+    unsigned hashes_;
+};
+
+/**
+ * @brief Constructor
+ *
+ * @param keys - expected number of keys
+ * @param bitsPerKey - bits per key, more means fewer false positives
+ */
+inline BloomFilter::BloomFilter(std::size_t keys, unsigned bitsPerKey)
+    : bits_(keys > 0 ? (keys * bitsPerKey + 63) / 64 : 0, 0),
+      hashes_(bitsPerKey * 69 / 100 > 0 ? bitsPerKey * 69 / 100 : 1) // bits per key * ln 2
+{
+}
+
+inline BloomFilter::~BloomFilter()
+{
+}
+
+inline void BloomFilter::add(const char *key, std::size_t length)
+{
+    if (bits_.empty())
+    {
+        return;
+    }
+    const std::uint64_t hash(hashOf(key, length));
+    const std::uint64_t bits(bits_.size() * 64);
+    std::uint64_t position(hash);
+    const std::uint64_t step((hash >> 33) | (hash << 31) | 1);
+    for (unsigned index = 0; index < hashes_; ++index, position += step)
+    {
+        bits_[(position % bits) / 64] |= std::uint64_t(1) << (position % 64);
+    }
+}
+
+/**
+ * @return false - if the key was certainly not added
+ */
+inline bool BloomFilter::mayContain(const char *key, std::size_t length) const
+{
+    if (bits_.empty())
+    {
+        return true;
+    }
+    const std::uint64_t hash(hashOf(key, length));
+    const std::uint64_t bits(bits_.size() * 64);
+    std::uint64_t position(hash);
+    const std::uint64_t step((hash >> 33) | (hash << 31) | 1);
+    for (unsigned index = 0; index < hashes_; ++index, position += step)
+    {
+        if ((bits_[(position % bits) / 64] & (std::uint64_t(1) << (position % 64))) == 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+inline std::size_t BloomFilter::bitCount() const
+{
+    return bits_.size() * 64;
+}
+
+/**
+ * @brief Writes the filter to a file (host byte order) with a checksum.
+ *        The file is synced and replaced atomically.
+ *
+ * @return true - if succeded, false - otherwise
+ */
+inline bool BloomFilter::save(const std::string &path) const
+{
+    const std::string temporary(path + ".tmp");
+    {
+        std::ofstream stream(temporary.c_str(), std::ios::binary | std::ios::trunc);
+        const std::uint64_t words(bits_.size());
+        const std::uint64_t hashes(hashes_);
+        const std::uint64_t checksum(checksumOf(bits_, hashes));
+        stream.write("TLBLOOM1", 8);
+        stream.write(reinterpret_cast<const char *>(&hashes), sizeof(hashes));
+        stream.write(reinterpret_cast<const char *>(&words), sizeof(words));
+        stream.write(reinterpret_cast<const char *>(&checksum), sizeof(checksum));
+        if (!bits_.empty())
+        {
+            stream.write(reinterpret_cast<const char *>(bits_.data()),
+                         static_cast<std::streamsize>(words * sizeof(std::uint64_t)));
+        }
+        stream.close();
+        if (!stream.good() || !syncFile(temporary, false))
+        {
+            std::remove(temporary.c_str());
+            return false;
+        }
+    }
+    if (std::rename(temporary.c_str(), path.c_str()) != 0)
+    {
+        std::remove(temporary.c_str());
+        return false;
+    }
+    const std::string::size_type slash(path.find_last_of('/'));
+    return syncFile(slash == std::string::npos ? std::string(".") : path.substr(0, slash + 1), true);
+}
+
+/**
+ * @brief Reads a filter written by save()
+ *
+ * @return false - if the file is missing, invalid or corrupt, the filter is unchanged
+ */
+inline bool BloomFilter::load(const std::string &path)
+{
+    std::ifstream stream(path.c_str(), std::ios::binary);
+    char magic[8] = {};
+    std::uint64_t hashes(0);
+    std::uint64_t words(0);
+    std::uint64_t checksum(0);
+    stream.read(magic, sizeof(magic));
+    stream.read(reinterpret_cast<char *>(&hashes), sizeof(hashes));
+    stream.read(reinterpret_cast<char *>(&words), sizeof(words));
+    stream.read(reinterpret_cast<char *>(&checksum), sizeof(checksum));
+    if (!stream.good() || std::memcmp(magic, "TLBLOOM1", sizeof(magic)) != 0 || hashes == 0 || hashes > 64 ||
+        words > (std::uint64_t(1) << 32))
+    {
+        return false;
+    }
+
+    // Check the size before allocating it
+    const std::streamoff header(stream.tellg());
+    stream.seekg(0, std::ios::end);
+    if (stream.tellg() - header != static_cast<std::streamoff>(words * sizeof(std::uint64_t)))
+    {
+        return false;
+    }
+    stream.seekg(header, std::ios::beg);
+
+    std::vector<std::uint64_t> bits(static_cast<std::size_t>(words));
+    if (words > 0)
+    {
+        stream.read(reinterpret_cast<char *>(bits.data()), static_cast<std::streamsize>(words * sizeof(std::uint64_t)));
+        if (!stream.good())
+        {
+            return false;
+        }
+    }
+    if (checksumOf(bits, hashes) != checksum)
+    {
+        return false;
+    }
+    bits_.swap(bits);
+    hashes_ = static_cast<unsigned>(hashes);
+    return true;
+}
+
+/**
+ * @brief FNV-1a, finished with a multiply-xorshift so both halves are mixed
+ */
+inline std::uint64_t BloomFilter::hashOf(const char *key, std::size_t length)
+{
+    std::uint64_t hash(14695981039346656037ull);
+    for (std::size_t index = 0; index < length; ++index)
+    {
+        hash ^= static_cast<unsigned char>(key[index]);
+        hash *= 1099511628211ull;
+    }
+    hash ^= hash >> 32;
+    hash *= 0xd6e8feb86659fd93ull;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+inline std::uint64_t BloomFilter::checksumOf(const std::vector<std::uint64_t> &bits, std::uint64_t hashes)
+{
+    const std::uint64_t hash(bits.empty() ? 0 : hashOf(reinterpret_cast<const char *>(bits.data()),
+                                                        bits.size() * sizeof(std::uint64_t)));
+    return hash ^ (hashes * 0x9e3779b97f4a7c15ull) ^ bits.size();
+}
+
+/**
+ * @brief Flushes a file or a directory (its entries) to the disk
+ */
+inline bool BloomFilter::syncFile(const std::string &path, bool directory)
+{
+    const int fd(open(path.c_str(), (directory ? O_RDONLY | O_DIRECTORY : O_RDONLY) | O_CLOEXEC));
+    if (fd < 0)
+    {
+        return false;
+    }
+    const bool synced(fsync(fd) == 0);
+    close(fd);
+    return synced;
+}
+}
@@ -0,0 +1,511 @@
+// MIT License
+// 
+// Copyright(c) 2018 Alex Tversky
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#pragma once
+
+#include "Util/IPairWrittable.hpp"
+#include "Util/RadixIndex.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Util
+{
+/**
+ *  \brief CachingPairWrittable - read-through in-process cache over any IPairWrittable
+ *
+ *  \details Values of exact keys are cached in shards, each one a hash map
+ *           plus an LRU list under its own mutex, so concurrent readers of
+ *           different keys rarely contend. Every shard holds an equal part
+ *           of the byte budget and evicts its least recently used entries
+ *           beyond it. Entries expire after their TTL. Writes go through to
+ *           the backend and refresh the cached value; a value read through
+ *           is not cached if its shard was written to during the backend
+ *           read, so it never replaces a newer one. Keys with "\*" notation
+ *           getKeyValue() and visitPages() are passed through uncached.
+ */
+class CachingPairWrittable : public IPairWrittable
+{
+  public:
+    typedef std::chrono::steady_clock Clock;
+    typedef std::function<std::chrono::milliseconds(const std::string &key)> TtlPolicy;
+
+    /**
+     *  \brief Cache counters
+     */
+    struct Statistics
+    {
+        std::uint64_t hits;
+        std::uint64_t misses;
+        std::uint64_t evictions;   // dropped to stay within the byte budget
+        std::uint64_t expirations; // dropped after their TTL
+        std::size_t entries;
+        std::size_t bytes;
+    };
+
+    using IPairWrittable::getValue;
+    using IPairWrittable::setValue;
+
+    CachingPairWrittable(IPairWrittable &backend, std::size_t byteBudget, std::chrono::milliseconds ttl,
+                         unsigned shards = 16);
+    virtual ~CachingPairWrittable();
+
+    bool getKeyValue(const std::string &key, std::vector<KeyValuePair> &values) override;
+    bool getValue(const std::string &key, std::vector<std::string> &values) override;
+    bool setValue(const std::string &key, const std::string &value) override;
+    bool getValues(const std::vector<std::string> &keys, std::vector<std::string> &values) override;
+    bool setValues(const std::vector<KeyValuePair> &pairs) override;
+    bool getValue(const char *key, std::size_t keyLength, std::string &value) override;
+    bool visitPages(const std::string &key, std::size_t pageSize, const PageVisitor &visitor) override;
+
+    void setTtlPolicy(const TtlPolicy &policy);
+    void invalidate(const std::string &key);
+    void invalidatePrefix(const std::string &prefix);
+    void clear();
+    Statistics statistics() const;
+
+  private:
+    CachingPairWrittable(const CachingPairWrittable &other) = delete;
+    CachingPairWrittable(const CachingPairWrittable &&other) = delete;
+    CachingPairWrittable &operator=(const CachingPairWrittable &other) = delete;
+    CachingPairWrittable &operator=(const CachingPairWrittable &&other) = delete;
+
+    static const std::size_t entryOverhead = 64; // list node, map node, bookkeeping
+
+    struct Entry
+    {
+        std::string key;
+        std::string value;
+        Clock::time_point expiry;
+    };
+
+    struct Shard
+    {
+        Shard() : bytes(0), generation(0)
+        {
+        }
+
+        std::list<Entry> lru; // most recently used first
+        std::unordered_map<std::string, std::list<Entry>::iterator> index;
+        RadixIndex keys; // the same keys, for invalidatePrefix()
+        std::shared_ptr<const TtlPolicy> ttlPolicy; // a copy per shard: no lock shared by shards
+        std::size_t bytes;
+        std::uint64_t generation; // bumped by every write: a fill read before it may be stale
+        std::mutex mutex;
+    };
+
+    static bool isWildcard(const std::string &key);
+    static std::size_t sizeOf(const Entry &entry);
+    Shard &shardOf(const std::string &key);
+    bool lookup(const std::string &key, std::string &value, std::uint64_t &generation);
+    void store(const std::string &key, const std::string &value);
+    void fill(const std::string &key, const std::string &value, std::uint64_t generation);
+    void insert(Shard &shard, const std::string &key, const std::string &value);
+    void erase(Shard &shard, std::list<Entry>::iterator entry);
+
+  private:
+    IPairWrittable &backend_;
+    const std::size_t shardBudget_;
+    const std::chrono::milliseconds ttl_;
+    std::vector<std::unique_ptr<Shard>> shards_;
+    std::atomic<std::uint64_t> hits_;
+    std::atomic<std::uint64_t> misses_;
+    std::atomic<std::uint64_t> evictions_;
+    std::atomic<std::uint64_t> expirations_;
+};
+
+/**
+ * @brief Constructor
+ *
+ * @param backend - a provider to read through, must outlive this object
+ * @param byteBudget - the most bytes of keys, values and bookkeeping to cache
+ * @param ttl - how long a cached value stays valid
+ * @param shards - number of independently locked shards
+ */
+inline CachingPairWrittable::CachingPairWrittable(IPairWrittable &backend, std::size_t byteBudget,
+                                                  std::chrono::milliseconds ttl, unsigned shards)
+    : backend_(backend), shardBudget_(byteBudget / (shards > 0 ? shards : 1)), ttl_(ttl),
+      hits_(0), misses_(0), evictions_(0), expirations_(0)
+{
+    for (unsigned index = 0; index < (shards > 0 ? shards : 1); ++index)
+    {
+        shards_.push_back(std::unique_ptr<Shard>(new Shard()));
+    }
+}
+
+inline CachingPairWrittable::~CachingPairWrittable()
+{
+}
+
+/**
+ * @brief Passed through to the backend, uncached
+ */
+inline bool CachingPairWrittable::getKeyValue(const std::string &key, std::vector<KeyValuePair> &values)
+{
+    return backend_.getKeyValue(key, values);
+}
+
+/**
+ * @brief Retrieves value/s by key, from the cache if possible
+ *
+ * @param [in] key - a key ("\*" notation is passed through uncached)
+ * @param [out] values - a single or multiple values
+ * @return true - if key found
+ * @return false - if key not found
+ */
+inline bool CachingPairWrittable::getValue(const std::string &key, std::vector<std::string> &values)
+{
+    if (isWildcard(key))
+    {
+        return backend_.getValue(key, values);
+    }
+
+    values.resize(1);
+    std::uint64_t generation(0);
+    if (lookup(key, values[0], generation))
+    {
+        return true;
+    }
+    if (backend_.getValue(key, values) && !values.empty())
+    {
+        fill(key, values[0], generation);
+        return true;
+    }
+    values.clear();
+    return false;
+}
+
+/**
+ * @brief Retrieves a value into the caller's string, from the cache if possible
+ */
+inline bool CachingPairWrittable::getValue(const char *key, std::size_t keyLength, std::string &value)
+{
+    const std::string cacheKey(key, keyLength);
+    std::uint64_t generation(0);
+    if (lookup(cacheKey, value, generation))
+    {
+        return true;
+    }
+    if (backend_.getValue(key, keyLength, value))
+    {
+        fill(cacheKey, value, generation);
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Passed through to the backend, uncached
+ */
+inline bool CachingPairWrittable::visitPages(const std::string &key, std::size_t pageSize, const PageVisitor &visitor)
+{
+    return backend_.visitPages(key, pageSize, visitor);
+}
+
+/**
+ * @brief Sets value in the backend, then in the cache
+ *
+ * @return true - if succeded, false - otherwise (the cached value is dropped)
+ */
+inline bool CachingPairWrittable::setValue(const std::string &key, const std::string &value)
+{
+    const bool status(backend_.setValue(key, value));
+    if (status)
+    {
+        store(key, value);
+    }
+    else
+    {
+        invalidate(key);
+    }
+    return status;
+}
+
+/**
+ * @brief Retrieves values of many exact keys, reading only the misses from the backend
+ */
+inline bool CachingPairWrittable::getValues(const std::vector<std::string> &keys, std::vector<std::string> &values)
+{
+    resetValues(values, keys.size());
+    std::vector<std::size_t> missed;
+    std::vector<std::string> missedKeys;
+    std::vector<std::uint64_t> generations;
+    for (std::size_t index = 0; index < keys.size(); ++index)
+    {
+        std::uint64_t generation(0);
+        if (!lookup(keys[index], values[index], generation))
+        {
+            missed.push_back(index);
+            missedKeys.push_back(keys[index]);
+            generations.push_back(generation);
+        }
+    }
+    if (missed.empty())
+    {
+        return true;
+    }
+
+    std::vector<std::string> missedValues;
+    const bool found(backend_.getValues(missedKeys, missedValues));
+    for (std::size_t index = 0; index < missed.size() && index < missedValues.size(); ++index)
+    {
+        if (!missedValues[index].empty())
+        {
+            fill(missedKeys[index], missedValues[index], generations[index]);
+            values[missed[index]].swap(missedValues[index]);
+        }
+    }
+    return found;
+}
+
+/**
+ * @brief Sets many values in the backend, then in the cache
+ */
+inline bool CachingPairWrittable::setValues(const std::vector<KeyValuePair> &pairs)
+{
+    const bool status(backend_.setValues(pairs));
+    for (const KeyValuePair &pair : pairs)
+    {
+        if (status)
+        {
+            store(pair.key, pair.value);
+        }
+        else
+        {
+            invalidate(pair.key); // some may have been set
+        }
+    }
+    return status;
+}
+
+/**
+ * @brief Sets a TTL per key, overriding the constructor one
+ *
+ * @param policy - returns the TTL of a key about to be cached, zero not to cache it;
+ *                 called under the lock of the key's shard, so keep it cheap
+ */
+inline void CachingPairWrittable::setTtlPolicy(const TtlPolicy &policy)
+{
+    const std::shared_ptr<const TtlPolicy> shared(policy ? new TtlPolicy(policy) : nullptr);
+    for (const std::unique_ptr<Shard> &shard : shards_)
+    {
+        std::lock_guard<std::mutex> guard(shard->mutex);
+        shard->ttlPolicy = shared;
+    }
+}
+
+/**
+ * @brief Drops a cached value, e.g. after it changed behind the cache
+ */
+inline void CachingPairWrittable::invalidate(const std::string &key)
+{
+    Shard &shard = shardOf(key);
+    std::lock_guard<std::mutex> guard(shard.mutex);
+    ++shard.generation;
+    auto found = shard.index.find(key);
+    if (found != shard.index.end())
+    {
+        erase(shard, found->second);
+    }
+}
+
+/**
+ * @brief Drops cached values of all keys starting with a prefix, e.g.
+ *        "printer/terminal/" after that subtree changed behind the cache.
+ *        Costs the prefix plus the keys dropped per shard, not a full scan.
+ */
+inline void CachingPairWrittable::invalidatePrefix(const std::string &prefix)
+{
+    std::vector<std::string> keys;
+    for (std::unique_ptr<Shard> &shard : shards_)
+    {
+        std::lock_guard<std::mutex> guard(shard->mutex);
+        ++shard->generation;
+        keys.clear();
+        shard->keys.visitPrefix(prefix, [&keys](const std::string &key) {
+            keys.push_back(key);
+            return true;
+        });
+        for (const std::string &key : keys)
+        {
+            auto found = shard->index.find(key);
+            if (found != shard->index.end())
+            {
+                erase(*shard, found->second);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Drops all cached values
+ */
+inline void CachingPairWrittable::clear()
+{
+    for (std::unique_ptr<Shard> &shard : shards_)
+    {
+        std::lock_guard<std::mutex> guard(shard->mutex);
+        ++shard->generation;
+        shard->index.clear();
+        shard->keys.clear();
+        shard->lru.clear();
+        shard->bytes = 0;
+    }
+}
+
+inline CachingPairWrittable::Statistics CachingPairWrittable::statistics() const
+{
+    Statistics result;
+    result.hits = hits_.load(std::memory_order_relaxed);
+    result.misses = misses_.load(std::memory_order_relaxed);
+    result.evictions = evictions_.load(std::memory_order_relaxed);
+    result.expirations = expirations_.load(std::memory_order_relaxed);
+    result.entries = 0;
+    result.bytes = 0;
+    for (const std::unique_ptr<Shard> &shard : shards_)
+    {
+        std::lock_guard<std::mutex> guard(shard->mutex);
+        result.entries += shard->index.size();
+        result.bytes += shard->bytes;
+    }
+    return result;
+}
+
+inline bool CachingPairWrittable::isWildcard(const std::string &key)
+{
+    return !key.empty() && '*' == key.back();
+}
+
+inline std::size_t CachingPairWrittable::sizeOf(const Entry &entry)
+{
+    return entry.key.size() * 3 + entry.value.size() + entryOverhead; // held by the entry, map and tree
+}
+
+inline CachingPairWrittable::Shard &CachingPairWrittable::shardOf(const std::string &key)
+{
+    return *shards_[std::hash<std::string>()(key) % shards_.size()];
+}
+
+/**
+ * @brief Looks a key up in the cache
+ *
+ * @param [out] generation - on a miss, the shard generation to fill() the value read with
+ */
+inline bool CachingPairWrittable::lookup(const std::string &key, std::string &value, std::uint64_t &generation)
+{
+    Shard &shard = shardOf(key);
+    std::lock_guard<std::mutex> guard(shard.mutex);
+    generation = shard.generation;
+    auto found = shard.index.find(key);
+    if (found == shard.index.end())
+    {
+        misses_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    if (found->second->expiry <= Clock::now())
+    {
+        erase(shard, found->second);
+        expirations_.fetch_add(1, std::memory_order_relaxed);
+        misses_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    shard.lru.splice(shard.lru.begin(), shard.lru, found->second);
+    value.assign(found->second->value);
+    hits_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+/**
+ * @brief Caches a value just written to the backend
+ */
+inline void CachingPairWrittable::store(const std::string &key, const std::string &value)
+{
+    Shard &shard = shardOf(key);
+    std::lock_guard<std::mutex> guard(shard.mutex);
+    ++shard.generation;
+    insert(shard, key, value);
+}
+
+/**
+ * @brief Caches a value read from the backend, unless a write to the shard
+ *        since the miss may have made it stale
+ */
+inline void CachingPairWrittable::fill(const std::string &key, const std::string &value, std::uint64_t generation)
+{
+    Shard &shard = shardOf(key);
+    std::lock_guard<std::mutex> guard(shard.mutex);
+    if (shard.generation == generation)
+    {
+        insert(shard, key, value);
+    }
+}
+
+inline void CachingPairWrittable::insert(Shard &shard, const std::string &key, const std::string &value)
+{
+    auto found = shard.index.find(key);
+    if (found != shard.index.end())
+    {
+        erase(shard, found->second);
+    }
+
+    const std::chrono::milliseconds ttl(shard.ttlPolicy ? (*shard.ttlPolicy)(key) : ttl_);
+    if (ttl.count() <= 0)
+    {
+        return; // not cached
+    }
+
+    Entry entry;
+    entry.key = key;
+    entry.value = value;
+    entry.expiry = Clock::now() + ttl;
+    const std::size_t bytes(sizeOf(entry));
+    if (bytes > shardBudget_)
+    {
+        return; // would evict everything else
+    }
+
+    while (shard.bytes + bytes > shardBudget_ && !shard.lru.empty())
+    {
+        erase(shard, std::prev(shard.lru.end()));
+        evictions_.fetch_add(1, std::memory_order_relaxed);
+    }
+    shard.lru.push_front(std::move(entry));
+    shard.index[key] = shard.lru.begin();
+    shard.keys.insert(key);
+    shard.bytes += bytes;
+}
+
+inline void CachingPairWrittable::erase(Shard &shard, std::list<Entry>::iterator entry)
+{
+    shard.bytes -= sizeOf(*entry);
+    shard.keys.erase(entry->key);
+    shard.index.erase(entry->key);
+    shard.lru.erase(entry);
+}
+}
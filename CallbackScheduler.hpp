@@ -0,0 +1,796 @@
+// MIT License
+//
+// Copyright(c) 2018 Alex Tversky
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#pragma once
+
+#include "Util/CallbackStatistics.hpp"
+#include "Util/InplaceFunction.hpp"
+#include "Util/ManualClock.hpp"
+#include "Util/ScheduleOptions.hpp"
+#include "Util/ThreadOptions.hpp"
+#include "Util/TimingWheel.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+namespace Util
+{
+/**
+ *  \brief Outcome of stopping a callback with a timeout
+ */
+enum StopResult
+{
+    SR_STOPPED = 0,  // no call in progress, the callback will not run again
+    SR_ABANDONED = 1 // a call is still blocked, it is left to finish on its own
+};
+
+/**
+ *  \brief CallbackStatus - the outcome of a callback call, by its result type
+ *
+ *  \details bool is the outcome, a ready std::future holds it and fails
+ *           if it holds an exception, any other result (void) counts as
+ *           a success.
+ */
+template <class Result>
+struct CallbackStatus
+{
+    template <class Callable>
+    static bool of(Callable &callable)
+    {
+        callable();
+        return true;
+    }
+};
+
+template <>
+struct CallbackStatus<bool>
+{
+    template <class Callable>
+    static bool of(Callable &callable)
+    {
+        return callable();
+    }
+};
+
+template <class T>
+struct CallbackStatus<std::future<T>>
+{
+    static bool of(std::future<T> &future)
+    {
+        try
+        {
+            auto result = [&future]() { return future.get(); };
+            return CallbackStatus<T>::of(result);
+        }
+        catch (...)
+        {
+            return false;
+        }
+    }
+};
+
+/**
+ *  \brief StatusCallable - adapts a callable of any result to one returning its status
+ */
+template <class Callable, class Result = typename std::decay<decltype(std::declval<Callable &>()())>::type>
+struct StatusCallable
+{
+    bool operator()()
+    {
+        return CallbackStatus<Result>::of(callable);
+    }
+
+    Callable callable;
+};
+
+/**
+ *  \brief StatusCallable - polls the future of a call instead of blocking on it
+ *
+ *  \details While the future is not ready the callable is not called again
+ *           and each call counts as a success; the call which finds it ready
+ *           reports its outcome. A deferred future runs on the calling thread.
+ */
+template <class Callable, class T>
+struct StatusCallable<Callable, std::future<T>>
+{
+    StatusCallable(const Callable &callable) : callable(callable), pending()
+    {
+    }
+
+    StatusCallable(Callable &&callable) : callable(std::move(callable)), pending()
+    {
+    }
+
+    bool operator()()
+    {
+        if (!pending.valid())
+        {
+            pending = callable();
+        }
+        if (pending.valid() && pending.wait_for(std::chrono::seconds(0)) == std::future_status::timeout)
+        {
+            return true;
+        }
+        std::future<T> ready(std::move(pending));
+        return ready.valid() && CallbackStatus<std::future<T>>::of(ready);
+    }
+
+    Callable callable;
+    std::future<T> pending;
+};
+
+template <class Callable>
+StatusCallable<typename std::decay<Callable>::type> makeStatusCallable(Callable &&callable)
+{
+    StatusCallable<typename std::decay<Callable>::type> result = {std::forward<Callable>(callable)};
+    return result;
+}
+
+/**
+ *  \brief BasicCallbackScheduler - runs many periodic callbacks on a small thread pool
+ *
+ *  \details Deadlines live in a hierarchical TimingWheel. One idle worker at a
+ *           time keeps time (sleeps until the next expiry), the others wait for
+ *           ready callbacks, so thread count is independent of task count.
+ *           A callback never runs concurrently with itself.
+ *           A task with slack sits in the wheel at its latest acceptable
+ *           time; any wakeup also runs tasks whose window has opened, so
+ *           callbacks with overlapping windows share one wakeup.
+ *           A callback returning a failed status (false, or a future holding
+ *           false or an exception) is retried as per ScheduleOptions::backoff.
+ *           The clock is a parameter: with a ManualClock and no pool threads
+ *           the caller drives simulated time with poll(), which measures pure
+ *           scheduling overhead without any real waiting.
+ */
+template <class ClockType>
+class BasicCallbackScheduler
+{
+  public:
+    typedef std::uint64_t TaskId;
+    typedef ClockType Clock;
+    typedef typename Clock::duration Duration;
+    typedef typename Clock::time_point TimePoint;
+    typedef InplaceFunction<void()> Callback;
+    typedef InplaceFunction<bool(), sizeof(Callback)> StatusCallback;
+    typedef BasicCallbackStatistics<Clock> Statistics;
+
+    explicit BasicCallbackScheduler(unsigned threads = defaultThreadCount(),
+                                    std::chrono::microseconds resolution = std::chrono::milliseconds(1),
+                                    const ThreadOptions &threadOptions = ThreadOptions());
+    virtual ~BasicCallbackScheduler();
+
+    template <class Callable>
+    TaskId add(std::chrono::nanoseconds period, Callable &&callable,
+               const ScheduleOptions &options = ScheduleOptions());
+    bool remove(TaskId id);
+    StopResult remove(TaskId id, std::chrono::nanoseconds timeout);
+
+    bool statistics(TaskId id, typename Statistics::Snapshot &snapshot) const;
+    std::shared_ptr<const Statistics> statisticsOf(TaskId id) const;
+    bool nextFireTime(TaskId id, TimePoint &time) const;
+    void statistics(std::unordered_map<TaskId, typename Statistics::Snapshot> &snapshots) const;
+
+    std::size_t taskCount() const;
+    std::size_t threadCount() const;
+
+    std::uint64_t wakeups() const;
+    std::uint64_t firings() const;
+    std::uint64_t wakeupsSaved() const;
+
+    std::size_t poll();
+
+    static unsigned defaultThreadCount();
+
+  private:
+    BasicCallbackScheduler(const BasicCallbackScheduler &other) = delete;
+    BasicCallbackScheduler(const BasicCallbackScheduler &&other) = delete;
+    BasicCallbackScheduler &operator=(const BasicCallbackScheduler &other) = delete;
+    BasicCallbackScheduler &operator=(const BasicCallbackScheduler &&other) = delete;
+
+    struct Task : TimingWheelNode
+    {
+        TaskId id;
+        Duration period;
+        ScheduleOptions options;
+        TimePoint deadline;
+        StatusCallback callback;
+        std::shared_ptr<Statistics> statistics;
+        unsigned failures;
+        std::uint64_t random;
+        std::thread::id runner;
+        bool ready;
+        bool running;
+        bool removeRequested;
+    };
+
+    /**
+     *  \brief A pool thread's hand-off point, it outlives the scheduler when the
+     *         thread is detached to finish an abandoned call
+     */
+    struct Worker
+    {
+        std::mutex mutex;
+        Task *current;              // guarded by the scheduler mutex
+        bool orphaned;              // guarded by mutex, as is task
+        std::unique_ptr<Task> task; // an abandoned task handed over on destruction
+    };
+
+    void work(Worker *worker);
+    void collect(TimePoint now);
+    bool runReady(std::unique_lock<std::mutex> &lock, Worker *worker);
+    void schedule(Task &task, TimePoint deadline);
+    void unschedule(Task &task);
+    std::uint64_t tickOf(TimePoint time) const;
+    std::uint64_t dueTickOf(TimePoint time) const;
+    TimePoint timeOf(std::uint64_t tick) const;
+
+  private:
+    const TimePoint epoch_;
+    const Duration resolution_;
+    TimingWheel wheel_;
+    std::unordered_map<TaskId, std::unique_ptr<Task>> tasks_;
+    std::deque<Task *> ready_;
+    TaskId lastId_;
+    bool running_;
+    bool timekeeper_;
+    std::uint64_t wakeTick_;
+    std::uint64_t maxSlackTicks_;
+    std::uint64_t wakeups_;
+    std::uint64_t firings_;
+    mutable std::mutex mutex_;
+    std::condition_variable timerCv_;
+    std::condition_variable workCv_;
+    std::condition_variable doneCv_;
+    std::vector<std::thread> threads_;
+    std::vector<std::shared_ptr<Worker>> workers_;
+};
+
+/**
+ * @brief Constructor
+ *
+ * @param threads - number of pool threads, 0 for none: the caller runs callbacks with poll()
+ * @param resolution - a timer resolution
+ * @param threadOptions - name, affinity and scheduling of the pool threads,
+ *        a pool of several threads numbers their names
+ */
+template <class ClockType>
+BasicCallbackScheduler<ClockType>::BasicCallbackScheduler(unsigned threads, std::chrono::microseconds resolution,
+                                            const ThreadOptions &threadOptions)
+    : epoch_(Clock::now()),
+      resolution_(std::chrono::duration_cast<Duration>(resolution).count() > 0
+                      ? std::chrono::duration_cast<Duration>(resolution)
+                      : Duration(1)),
+      lastId_(0), running_(true), timekeeper_(false), wakeTick_(0), maxSlackTicks_(0),
+      wakeups_(0), firings_(0)
+{
+    for (unsigned index = 0; index < threads; ++index)
+    {
+        ThreadOptions options(threadOptions);
+        if (threads > 1 && !options.name.empty())
+        {
+            options.name = options.name.substr(0, 12) + std::to_string(index);
+        }
+        std::shared_ptr<Worker> worker(std::make_shared<Worker>());
+        worker->current = nullptr;
+        worker->orphaned = false;
+        workers_.push_back(worker);
+        threads_.push_back(std::thread([this, options, worker]() {
+            applyThreadOptions(options);
+            work(worker.get());
+        }));
+    }
+}
+
+template <class ClockType>
+BasicCallbackScheduler<ClockType>::~BasicCallbackScheduler()
+{
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        running_ = false;
+    }
+    timerCv_.notify_all();
+    workCv_.notify_all();
+    for (std::size_t index = 0; index < threads_.size(); ++index)
+    {
+        Worker &worker = *workers_[index];
+        {
+            std::lock_guard<std::mutex> handoff(worker.mutex);
+            std::lock_guard<std::mutex> guard(mutex_);
+            if (worker.current && worker.current->removeRequested)
+            {
+                // An abandoned call: the thread owns the task and exits once the call returns
+                auto found = tasks_.find(worker.current->id);
+                worker.task = std::move(found->second);
+                tasks_.erase(found);
+                worker.orphaned = true;
+                threads_[index].detach();
+                continue;
+            }
+        }
+        if (threads_[index].joinable())
+        {
+            threads_[index].join();
+        }
+    }
+}
+
+/**
+ * @brief Adds a periodic callback; the first call happens immediately unless aligned
+ *
+ * @param period - a period (deadlines are rounded up to the scheduler resolution)
+ * @param callable - a callable taking no arguments, should not block; it may
+ *        return a status (bool or std::future) to back off on failure
+ * @param options - fixed delay/rate mode, overrun policy, alignment and backoff
+ * @return an id to be passed to remove()
+ */
+template <class ClockType>
+template <class Callable>
+typename BasicCallbackScheduler<ClockType>::TaskId BasicCallbackScheduler<ClockType>::add(
+    std::chrono::nanoseconds period, Callable &&callable, const ScheduleOptions &options)
+{
+    std::unique_ptr<Task> task(new Task());
+    task->period = std::chrono::duration_cast<Duration>(period);
+    task->options = options;
+    task->callback = makeStatusCallable(std::forward<Callable>(callable));
+    task->statistics = std::make_shared<Statistics>();
+    task->failures = 0;
+    task->ready = false;
+    task->running = false;
+    task->removeRequested = false;
+
+    std::lock_guard<std::mutex> guard(mutex_);
+    const std::uint64_t slackTicks(static_cast<std::uint64_t>(
+        std::chrono::duration_cast<Duration>(options.slack) / resolution_));
+    maxSlackTicks_ = slackTicks > maxSlackTicks_ ? slackTicks : maxSlackTicks_;
+    task->id = ++lastId_;
+    task->random = (task->id * 0x9E3779B97F4A7C15ULL) ^ reinterpret_cast<std::uintptr_t>(task.get()) ^
+                   static_cast<std::uint64_t>(epoch_.time_since_epoch().count());
+    task->random = task->random != 0 ? task->random : 1;
+    Task &ref = *task;
+    tasks_[ref.id] = std::move(task);
+    schedule(ref, firstDeadline(Clock::now(), ref.period, ref.options));
+    return ref.id;
+}
+
+/**
+ * @brief Removes a periodic callback
+ *
+ * @details Waits for a running call to return, unless called from that very callback.
+ * @return false - if there is no such task
+ */
+template <class ClockType>
+bool BasicCallbackScheduler<ClockType>::remove(TaskId id)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto found = tasks_.find(id);
+    if (found == tasks_.end() || found->second->removeRequested)
+    {
+        return false;
+    }
+
+    Task &task = *found->second;
+    if (task.running)
+    {
+        task.removeRequested = true;
+        if (task.runner != std::this_thread::get_id())
+        {
+            doneCv_.wait(lock, [this, id]() { return tasks_.find(id) == tasks_.end(); });
+        }
+        return true;
+    }
+
+    unschedule(task);
+    tasks_.erase(found);
+    return true;
+}
+
+/**
+ * @brief Removes a periodic callback, waiting at most timeout for a running call
+ *
+ * @details A call blocked past the timeout keeps its pool thread; the task is
+ *          erased once the call returns and is never scheduled again. The
+ *          destructor does not wait for it: the thread is detached and frees
+ *          the task when the call returns.
+ * @return SR_ABANDONED - if a call is still running, SR_STOPPED otherwise
+ *         (also if there is no such task)
+ */
+template <class ClockType>
+StopResult BasicCallbackScheduler<ClockType>::remove(TaskId id, std::chrono::nanoseconds timeout)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto found = tasks_.find(id);
+    if (found == tasks_.end())
+    {
+        return SR_STOPPED;
+    }
+
+    Task &task = *found->second;
+    if (!task.running)
+    {
+        unschedule(task);
+        tasks_.erase(found);
+        return SR_STOPPED;
+    }
+
+    task.removeRequested = true;
+    if (task.runner == std::this_thread::get_id())
+    {
+        return SR_STOPPED; // erased as soon as this very call returns
+    }
+    return doneCv_.wait_for(lock, timeout, [this, id]() { return tasks_.find(id) == tasks_.end(); })
+               ? SR_STOPPED
+               : SR_ABANDONED;
+}
+
+/**
+ * @brief Retrieves execution time, lateness and overrun statistics of a task
+ *
+ * @param [in] id - a task id
+ * @param [out] snapshot - the task statistics
+ * @return false - if there is no such task
+ */
+template <class ClockType>
+bool BasicCallbackScheduler<ClockType>::statistics(TaskId id, typename Statistics::Snapshot &snapshot) const
+{
+    std::lock_guard<std::mutex> guard(mutex_);
+    auto found = tasks_.find(id);
+    if (found == tasks_.end())
+    {
+        return false;
+    }
+    snapshot = found->second->statistics->snapshot();
+    return true;
+}
+
+/**
+ * @brief Shares the statistics of a task, e.g. with a CallbackWatchdog
+ *
+ * @return nullptr - if there is no such task
+ */
+template <class ClockType>
+std::shared_ptr<const typename BasicCallbackScheduler<ClockType>::Statistics>
+BasicCallbackScheduler<ClockType>::statisticsOf(TaskId id) const
+{
+    std::lock_guard<std::mutex> guard(mutex_);
+    auto found = tasks_.find(id);
+    if (found == tasks_.end())
+    {
+        return std::shared_ptr<const Statistics>();
+    }
+    return found->second->statistics;
+}
+
+/**
+ * @brief Retrieves the deadline of the next call of a task, later while it backs off
+ *
+ * @return false - if there is no such task
+ */
+template <class ClockType>
+bool BasicCallbackScheduler<ClockType>::nextFireTime(TaskId id, TimePoint &time) const
+{
+    std::lock_guard<std::mutex> guard(mutex_);
+    auto found = tasks_.find(id);
+    if (found == tasks_.end())
+    {
+        return false;
+    }
+    time = found->second->deadline;
+    return true;
+}
+
+/**
+ * @brief Retrieves statistics of all tasks, e.g. to find the slowest ones
+ *
+ * @param [out] snapshots - statistics by task id
+ */
+template <class ClockType>
+void BasicCallbackScheduler<ClockType>::statistics(
+    std::unordered_map<TaskId, typename Statistics::Snapshot> &snapshots) const
+{
+    snapshots.clear();
+    std::lock_guard<std::mutex> guard(mutex_);
+    for (const auto &task : tasks_)
+    {
+        snapshots[task.first] = task.second->statistics->snapshot();
+    }
+}
+
+template <class ClockType>
+std::size_t BasicCallbackScheduler<ClockType>::taskCount() const
+{
+    std::lock_guard<std::mutex> guard(mutex_);
+    return tasks_.size();
+}
+
+template <class ClockType>
+std::size_t BasicCallbackScheduler<ClockType>::threadCount() const
+{
+    return threads_.size();
+}
+
+/**
+ * @brief Returns number of wakeups which ran at least one callback
+ */
+template <class ClockType>
+std::uint64_t BasicCallbackScheduler<ClockType>::wakeups() const
+{
+    std::lock_guard<std::mutex> guard(mutex_);
+    return wakeups_;
+}
+
+/**
+ * @brief Returns number of callback runs
+ */
+template <class ClockType>
+std::uint64_t BasicCallbackScheduler<ClockType>::firings() const
+{
+    std::lock_guard<std::mutex> guard(mutex_);
+    return firings_;
+}
+
+/**
+ * @brief Returns number of wakeups saved by running several callbacks per wakeup
+ */
+template <class ClockType>
+std::uint64_t BasicCallbackScheduler<ClockType>::wakeupsSaved() const
+{
+    std::lock_guard<std::mutex> guard(mutex_);
+    return firings_ - wakeups_;
+}
+
+/**
+ * @brief Runs on the calling thread every callback due at the current clock time
+ *
+ * @details Meant for a scheduler without pool threads, e.g. driven by a ManualClock.
+ * @return number of callbacks run
+ */
+template <class ClockType>
+std::size_t BasicCallbackScheduler<ClockType>::poll()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    collect(Clock::now());
+    std::size_t ran(0);
+    while (!ready_.empty())
+    {
+        runReady(lock, nullptr);
+        ++ran;
+    }
+    return ran;
+}
+
+/**
+ * @brief Returns the number of hardware threads, at least 1
+ */
+template <class ClockType>
+unsigned BasicCallbackScheduler<ClockType>::defaultThreadCount()
+{
+    const unsigned count(std::thread::hardware_concurrency());
+    return count > 0 ? count : 1;
+}
+
+template <class ClockType>
+void BasicCallbackScheduler<ClockType>::work(Worker *worker)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (running_)
+    {
+        if (!ready_.empty())
+        {
+            if (!runReady(lock, worker))
+            {
+                return; // the scheduler is gone
+            }
+            continue;
+        }
+
+        if (timekeeper_)
+        {
+            workCv_.wait(lock);
+            continue;
+        }
+
+        // Keep time: move expired tasks to the ready queue or sleep until next expiry
+        timekeeper_ = true;
+        collect(Clock::now());
+
+        if (ready_.empty())
+        {
+            std::uint64_t tick(0);
+            if (wheel_.nextExpiry(tick))
+            {
+                wakeTick_ = tick;
+                ClockTraits<Clock>::waitUntil(timerCv_, lock, timeOf(tick), [this, tick]() {
+                    return !running_ || wakeTick_ != tick;
+                });
+            }
+            else
+            {
+                wakeTick_ = UINT64_MAX;
+                timerCv_.wait(lock);
+            }
+        }
+        else
+        {
+            // Hand over time keeping and spare ready tasks to idle workers
+            workCv_.notify_all();
+        }
+        timekeeper_ = false;
+    }
+}
+
+/**
+ * @brief Moves tasks expired at the given time to the ready queue
+ */
+template <class ClockType>
+void BasicCallbackScheduler<ClockType>::collect(TimePoint now)
+{
+    const std::uint64_t dueTick(dueTickOf(now));
+    std::uint64_t readied(0);
+    auto makeReady = [this, &readied](TimingWheelNode &node) {
+        Task &task = static_cast<Task &>(node);
+        task.ready = true;
+        ready_.push_back(&task);
+        ++readied;
+    };
+    wheel_.advance(dueTick, makeReady);
+    if (readied > 0)
+    {
+        if (maxSlackTicks_ > 0)
+        {
+            // Awake anyway: also run tasks whose slack window is already open
+            wheel_.extractIf(dueTick + maxSlackTicks_, [now](const TimingWheelNode &node) {
+                return static_cast<const Task &>(node).deadline <= now;
+            }, makeReady);
+        }
+        ++wakeups_;
+        firings_ += readied;
+    }
+}
+
+/**
+ * @brief Runs the first ready task with the lock released, then reschedules it
+ *
+ * @param worker - the pool thread's hand-off point, nullptr for poll()
+ * @return false - if the scheduler was destroyed during an abandoned call,
+ *         the task is freed and nothing else may be touched
+ */
+template <class ClockType>
+bool BasicCallbackScheduler<ClockType>::runReady(std::unique_lock<std::mutex> &lock, Worker *worker)
+{
+    Task &task = *ready_.front();
+    ready_.pop_front();
+    task.ready = false;
+    task.running = true;
+    task.runner = std::this_thread::get_id();
+    if (worker)
+    {
+        worker->current = &task;
+    }
+
+    lock.unlock();
+    const TimePoint started(Clock::now());
+    task.statistics->begin(started);
+    const bool succeeded(task.callback());
+    const TimePoint finished(Clock::now());
+    task.statistics->record(task.deadline, started, finished, task.period, succeeded);
+    if (worker)
+    {
+        std::lock_guard<std::mutex> handoff(worker->mutex);
+        if (worker->orphaned)
+        {
+            worker->task.reset();
+            return false;
+        }
+        lock.lock();
+        worker->current = nullptr;
+    }
+    else
+    {
+        lock.lock();
+    }
+
+    task.running = false;
+    if (task.removeRequested)
+    {
+        tasks_.erase(task.id);
+        doneCv_.notify_all();
+    }
+    else
+    {
+        schedule(task, nextDeadline(task.deadline, finished, task.period, task.options, succeeded,
+                                    task.failures, task.random));
+    }
+    return true;
+}
+
+template <class ClockType>
+void BasicCallbackScheduler<ClockType>::schedule(Task &task, TimePoint deadline)
+{
+    const std::uint64_t tick(tickOf(deadline + std::chrono::duration_cast<Duration>(task.options.slack)));
+    task.deadline = deadline;
+    wheel_.insert(task, tick);
+    if (timekeeper_ && tick < wakeTick_)
+    {
+        wakeTick_ = tick;
+        timerCv_.notify_one();
+    }
+}
+
+template <class ClockType>
+void BasicCallbackScheduler<ClockType>::unschedule(Task &task)
+{
+    if (task.ready)
+    {
+        for (auto it = ready_.begin(); it != ready_.end(); ++it)
+        {
+            if (*it == &task)
+            {
+                ready_.erase(it);
+                break;
+            }
+        }
+    }
+    wheel_.remove(task);
+}
+
+/**
+ * @brief Converts a time point to the first tick not earlier than it
+ */
+template <class ClockType>
+std::uint64_t BasicCallbackScheduler<ClockType>::tickOf(TimePoint time) const
+{
+    if (time <= epoch_)
+    {
+        return 0;
+    }
+    return static_cast<std::uint64_t>((time - epoch_ + resolution_ - Duration(1)) / resolution_);
+}
+
+/**
+ * @brief Converts a time point to the last tick which is due at it
+ */
+template <class ClockType>
+std::uint64_t BasicCallbackScheduler<ClockType>::dueTickOf(TimePoint time) const
+{
+    if (time <= epoch_)
+    {
+        return 0;
+    }
+    return static_cast<std::uint64_t>((time - epoch_) / resolution_);
+}
+
+template <class ClockType>
+typename BasicCallbackScheduler<ClockType>::TimePoint BasicCallbackScheduler<ClockType>::timeOf(std::uint64_t tick) const
+{
+    return epoch_ + resolution_ * static_cast<typename Clock::rep>(tick);
+}
+
+typedef BasicCallbackScheduler<std::chrono::steady_clock> CallbackScheduler;
+}
@@ -0,0 +1,295 @@
+// MIT License
+//
+// Copyright(c) 2018 Alex Tversky
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+namespace Util
+{
+/**
+ *  \brief CallbackStatistics - execution time and lateness of a periodic callback
+ *
+ *  \details Written by the single thread running the callback, readable from
+ *           any thread. Histograms use power-of-two microsecond buckets:
+ *           bucket 0 holds [0, 2us), bucket i holds [2^i, 2^(i+1)) us.
+ *           The call in progress, if any, is visible through running().
+ *           Times are kept on the clock of the timer running the callback,
+ *           e.g. simulated time of a ManualClock.
+ */
+template <class ClockType = std::chrono::steady_clock>
+class BasicCallbackStatistics
+{
+  public:
+    typedef ClockType Clock;
+    static const unsigned buckets = 32;
+
+    /**
+     *  \brief A copy of the counters, consistent per field
+     */
+    struct Snapshot
+    {
+        std::uint64_t runs;
+        std::uint64_t overruns;
+        std::uint64_t failures;
+        std::chrono::nanoseconds totalDuration;
+        std::chrono::nanoseconds maxDuration;
+        std::chrono::nanoseconds maxLateness;
+        typename Clock::time_point lastStart;
+        typename Clock::time_point lastFinish;
+        std::uint64_t duration[buckets];
+        std::uint64_t lateness[buckets];
+
+        std::chrono::nanoseconds durationPercentile(double percent) const
+        {
+            return percentile(duration, percent);
+        }
+
+        std::chrono::nanoseconds latenessPercentile(double percent) const
+        {
+            return percentile(lateness, percent);
+        }
+    };
+
+    BasicCallbackStatistics();
+    virtual ~BasicCallbackStatistics();
+
+    template <class TimePoint>
+    void begin(TimePoint started);
+    template <class TimePoint>
+    void record(TimePoint intended, TimePoint started, TimePoint finished,
+                typename TimePoint::duration period, bool succeeded = true);
+    void reset();
+    bool running(typename Clock::time_point &since, std::thread::id &thread) const;
+    Snapshot snapshot() const;
+
+    static std::chrono::nanoseconds bucketUpperBound(unsigned bucket);
+
+  private:
+    BasicCallbackStatistics(const BasicCallbackStatistics &other) = delete;
+    BasicCallbackStatistics(const BasicCallbackStatistics &&other) = delete;
+    BasicCallbackStatistics &operator=(const BasicCallbackStatistics &other) = delete;
+    BasicCallbackStatistics &operator=(const BasicCallbackStatistics &&other) = delete;
+
+    static unsigned bucketOf(std::chrono::nanoseconds value);
+    static void storeMax(std::atomic<std::int64_t> &target, std::int64_t value);
+    static std::chrono::nanoseconds percentile(const std::uint64_t (&histogram)[buckets], double percent);
+
+  private:
+    std::atomic<std::uint64_t> runs_;
+    std::atomic<std::uint64_t> overruns_;
+    std::atomic<std::uint64_t> failures_;
+    std::atomic<std::int64_t> totalDuration_;
+    std::atomic<std::int64_t> maxDuration_;
+    std::atomic<std::int64_t> maxLateness_;
+    std::atomic<typename Clock::rep> lastStart_;
+    std::atomic<typename Clock::rep> lastFinish_;
+    std::atomic<bool> running_;
+    std::atomic<typename Clock::rep> runningSince_;
+    std::atomic<std::thread::id> runner_;
+    std::atomic<std::uint64_t> duration_[buckets];
+    std::atomic<std::uint64_t> lateness_[buckets];
+};
+
+template <class ClockType>
+BasicCallbackStatistics<ClockType>::BasicCallbackStatistics()
+{
+    reset();
+}
+
+template <class ClockType>
+BasicCallbackStatistics<ClockType>::~BasicCallbackStatistics()
+{
+}
+
+/**
+ * @brief Marks a call in progress on the calling thread
+ */
+template <class ClockType>
+template <class TimePoint>
+void BasicCallbackStatistics<ClockType>::begin(TimePoint started)
+{
+    runner_.store(std::this_thread::get_id(), std::memory_order_relaxed);
+    runningSince_.store(std::chrono::duration_cast<typename Clock::duration>(started.time_since_epoch()).count(),
+                        std::memory_order_relaxed);
+    running_.store(true, std::memory_order_release);
+}
+
+/**
+ * @brief Records one call (and ends the call in progress)
+ *
+ * @param intended - the deadline the call was scheduled for
+ * @param started - the time the call started
+ * @param finished - the time the call returned
+ * @param period - the period; a call running longer counts as an overrun
+ * @param succeeded - the status reported by the call
+ */
+template <class ClockType>
+template <class TimePoint>
+void BasicCallbackStatistics<ClockType>::record(TimePoint intended, TimePoint started, TimePoint finished,
+                                typename TimePoint::duration period, bool succeeded)
+{
+    const std::chrono::nanoseconds duration(std::chrono::duration_cast<std::chrono::nanoseconds>(finished - started));
+    const std::chrono::nanoseconds lateness(started > intended
+                                                ? std::chrono::duration_cast<std::chrono::nanoseconds>(started - intended)
+                                                : std::chrono::nanoseconds::zero());
+
+    duration_[bucketOf(duration)].fetch_add(1, std::memory_order_relaxed);
+    lateness_[bucketOf(lateness)].fetch_add(1, std::memory_order_relaxed);
+    totalDuration_.fetch_add(duration.count(), std::memory_order_relaxed);
+    storeMax(maxDuration_, duration.count());
+    storeMax(maxLateness_, lateness.count());
+    if (period > TimePoint::duration::zero() && finished - started > period)
+    {
+        overruns_.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (!succeeded)
+    {
+        failures_.fetch_add(1, std::memory_order_relaxed);
+    }
+    lastStart_.store(std::chrono::duration_cast<typename Clock::duration>(started.time_since_epoch()).count(),
+                     std::memory_order_relaxed);
+    lastFinish_.store(std::chrono::duration_cast<typename Clock::duration>(finished.time_since_epoch()).count(),
+                      std::memory_order_relaxed);
+    running_.store(false, std::memory_order_relaxed);
+    runs_.fetch_add(1, std::memory_order_release);
+}
+
+/**
+ * @brief Retrieves the call in progress
+ *
+ * @param [out] since - the time the call started
+ * @param [out] thread - the thread running the call
+ * @return false - if no call is in progress
+ */
+template <class ClockType>
+bool BasicCallbackStatistics<ClockType>::running(typename Clock::time_point &since, std::thread::id &thread) const
+{
+    if (!running_.load(std::memory_order_acquire))
+    {
+        return false;
+    }
+    since = typename Clock::time_point(typename Clock::duration(runningSince_.load(std::memory_order_relaxed)));
+    thread = runner_.load(std::memory_order_relaxed);
+    return true;
+}
+
+template <class ClockType>
+void BasicCallbackStatistics<ClockType>::reset()
+{
+    runs_.store(0, std::memory_order_relaxed);
+    overruns_.store(0, std::memory_order_relaxed);
+    failures_.store(0, std::memory_order_relaxed);
+    totalDuration_.store(0, std::memory_order_relaxed);
+    maxDuration_.store(0, std::memory_order_relaxed);
+    maxLateness_.store(0, std::memory_order_relaxed);
+    lastStart_.store(0, std::memory_order_relaxed);
+    lastFinish_.store(0, std::memory_order_relaxed);
+    running_.store(false, std::memory_order_relaxed);
+    runningSince_.store(0, std::memory_order_relaxed);
+    runner_.store(std::thread::id(), std::memory_order_relaxed);
+    for (unsigned bucket = 0; bucket < buckets; ++bucket)
+    {
+        duration_[bucket].store(0, std::memory_order_relaxed);
+        lateness_[bucket].store(0, std::memory_order_relaxed);
+    }
+}
+
+template <class ClockType>
+typename BasicCallbackStatistics<ClockType>::Snapshot BasicCallbackStatistics<ClockType>::snapshot() const
+{
+    Snapshot result;
+    result.runs = runs_.load(std::memory_order_acquire);
+    result.overruns = overruns_.load(std::memory_order_relaxed);
+    result.failures = failures_.load(std::memory_order_relaxed);
+    result.totalDuration = std::chrono::nanoseconds(totalDuration_.load(std::memory_order_relaxed));
+    result.maxDuration = std::chrono::nanoseconds(maxDuration_.load(std::memory_order_relaxed));
+    result.maxLateness = std::chrono::nanoseconds(maxLateness_.load(std::memory_order_relaxed));
+    result.lastStart = typename Clock::time_point(typename Clock::duration(lastStart_.load(std::memory_order_relaxed)));
+    result.lastFinish = typename Clock::time_point(typename Clock::duration(lastFinish_.load(std::memory_order_relaxed)));
+    for (unsigned bucket = 0; bucket < buckets; ++bucket)
+    {
+        result.duration[bucket] = duration_[bucket].load(std::memory_order_relaxed);
+        result.lateness[bucket] = lateness_[bucket].load(std::memory_order_relaxed);
+    }
+    return result;
+}
+
+/**
+ * @brief Returns the exclusive upper bound of a histogram bucket
+ */
+template <class ClockType>
+std::chrono::nanoseconds BasicCallbackStatistics<ClockType>::bucketUpperBound(unsigned bucket)
+{
+    return std::chrono::microseconds(std::int64_t(2) << bucket);
+}
+
+template <class ClockType>
+unsigned BasicCallbackStatistics<ClockType>::bucketOf(std::chrono::nanoseconds value)
+{
+    std::uint64_t micros(static_cast<std::uint64_t>(value.count() / 1000) >> 1);
+    unsigned bucket(0);
+    while (micros != 0 && bucket + 1 < buckets)
+    {
+        micros >>= 1;
+        ++bucket;
+    }
+    return bucket;
+}
+
+template <class ClockType>
+void BasicCallbackStatistics<ClockType>::storeMax(std::atomic<std::int64_t> &target, std::int64_t value)
+{
+    std::int64_t current(target.load(std::memory_order_relaxed));
+    while (value > current &&
+           !target.compare_exchange_weak(current, value, std::memory_order_relaxed))
+    {
+    }
+}
+
+template <class ClockType>
+std::chrono::nanoseconds BasicCallbackStatistics<ClockType>::percentile(const std::uint64_t (&histogram)[buckets],
+                                                                        double percent)
+{
+    std::uint64_t total(0);
+    for (unsigned bucket = 0; bucket < buckets; ++bucket)
+    {
+        total += histogram[bucket];
+    }
+
+    const double rank(total * percent / 100.0);
+    std::uint64_t seen(0);
+    for (unsigned bucket = 0; bucket < buckets; ++bucket)
+    {
+        seen += histogram[bucket];
+        if (seen > 0 && seen >= rank)
+        {
+            return bucketUpperBound(bucket);
+        }
+    }
+    return std::chrono::nanoseconds::zero();
+}
+
+typedef BasicCallbackStatistics<std::chrono::steady_clock> CallbackStatistics;
+}
@@ -0,0 +1,250 @@
+// MIT License
+// 
+// Copyright(c) 2018 Alex Tversky
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#pragma once
+
+#include "Util/CallbackStatistics.hpp"
+#include "Util/ILogProvider.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Util
+{
+/**
+ *  \brief CallbackWatchdog - reports callbacks blocked longer than their budget
+ *
+ *  \details Polls the call in progress of every watched CallbackStatistics
+ *           from its own thread, so a hung callback is noticed while it is
+ *           still hung rather than when (if ever) it returns. Every blocked
+ *           call is logged once, as a warning naming the stuck thread.
+ *           Watches end by themselves when the statistics are destroyed.
+ *           Clock must match the statistics, e.g. ManualClock for callbacks
+ *           timed by a ManualClock; the checks themselves run in real time.
+ */
+template <class ClockType = std::chrono::steady_clock>
+class BasicCallbackWatchdog
+{
+  public:
+    typedef ClockType Clock;
+    typedef BasicCallbackStatistics<Clock> Statistics;
+
+    /**
+     *  \brief A call running longer than its budget
+     */
+    struct Report
+    {
+        std::string name;
+        std::thread::id thread;
+        std::chrono::nanoseconds duration;
+        std::chrono::nanoseconds budget;
+    };
+
+    explicit BasicCallbackWatchdog(ILogProvider &logger,
+                              std::chrono::milliseconds checkPeriod = std::chrono::milliseconds(100));
+    virtual ~BasicCallbackWatchdog();
+
+    void watch(const std::string &name, const std::weak_ptr<const Statistics> &statistics,
+               std::chrono::nanoseconds budget);
+
+    std::vector<Report> blocked() const;
+    std::uint64_t reports() const;
+    std::size_t watchCount() const;
+
+  private:
+    BasicCallbackWatchdog(const BasicCallbackWatchdog &other) = delete;
+    BasicCallbackWatchdog(const BasicCallbackWatchdog &&other) = delete;
+    BasicCallbackWatchdog &operator=(const BasicCallbackWatchdog &other) = delete;
+    BasicCallbackWatchdog &operator=(const BasicCallbackWatchdog &&other) = delete;
+
+    struct Watch
+    {
+        std::string name;
+        std::weak_ptr<const Statistics> statistics;
+        std::chrono::nanoseconds budget;
+        typename Clock::time_point reported; // start of the last call logged as blocked
+    };
+
+    void run();
+    void check(std::vector<std::string> &messages);
+
+  private:
+    ILogProvider &logger_;
+    const std::chrono::milliseconds checkPeriod_;
+    std::vector<Watch> watches_;
+    std::vector<Report> blocked_;
+    std::uint64_t reports_;
+    bool running_;
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::thread thread_;
+};
+
+template <class ClockType>
+BasicCallbackWatchdog<ClockType>::BasicCallbackWatchdog(ILogProvider &logger, std::chrono::milliseconds checkPeriod)
+    : logger_(logger),
+      checkPeriod_(checkPeriod.count() > 0 ? checkPeriod : std::chrono::milliseconds(1)),
+      reports_(0), running_(true)
+{
+    thread_ = std::thread(&BasicCallbackWatchdog::run, this);
+}
+
+template <class ClockType>
+BasicCallbackWatchdog<ClockType>::~BasicCallbackWatchdog()
+{
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        running_ = false;
+    }
+    cv_.notify_all();
+    if (thread_.joinable())
+    {
+        thread_.join();
+    }
+}
+
+/**
+ * @brief Watches a callback
+ *
+ * @param name - a name to report the callback by
+ * @param statistics - statistics of the callback, see CallbackScheduler::statisticsOf()
+ * @param budget - the longest acceptable call
+ */
+template <class ClockType>
+void BasicCallbackWatchdog<ClockType>::watch(const std::string &name, const std::weak_ptr<const Statistics> &statistics,
+                                             std::chrono::nanoseconds budget)
+{
+    Watch entry;
+    entry.name = name;
+    entry.statistics = statistics;
+    entry.budget = budget;
+    std::lock_guard<std::mutex> guard(mutex_);
+    watches_.push_back(entry);
+}
+
+/**
+ * @brief Returns calls found blocked by the last check
+ */
+template <class ClockType>
+std::vector<typename BasicCallbackWatchdog<ClockType>::Report> BasicCallbackWatchdog<ClockType>::blocked() const
+{
+    std::lock_guard<std::mutex> guard(mutex_);
+    return blocked_;
+}
+
+/**
+ * @brief Returns number of blocked calls reported so far
+ */
+template <class ClockType>
+std::uint64_t BasicCallbackWatchdog<ClockType>::reports() const
+{
+    std::lock_guard<std::mutex> guard(mutex_);
+    return reports_;
+}
+
+template <class ClockType>
+std::size_t BasicCallbackWatchdog<ClockType>::watchCount() const
+{
+    std::lock_guard<std::mutex> guard(mutex_);
+    return watches_.size();
+}
+
+template <class ClockType>
+void BasicCallbackWatchdog<ClockType>::run()
+{
+    std::vector<std::string> messages;
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (running_)
+    {
+        cv_.wait_for(lock, checkPeriod_, [this]() { return !running_; });
+        if (!running_)
+        {
+            break;
+        }
+
+        check(messages);
+        if (!messages.empty())
+        {
+            // The logger may be slow, do not hold up watch() and blocked()
+            lock.unlock();
+            for (const std::string &message : messages)
+            {
+                logger_.warn(message);
+            }
+            messages.clear();
+            lock.lock();
+        }
+    }
+}
+
+template <class ClockType>
+void BasicCallbackWatchdog<ClockType>::check(std::vector<std::string> &messages)
+{
+    const typename Clock::time_point now(Clock::now());
+    blocked_.clear();
+    for (std::size_t index = 0; index < watches_.size();)
+    {
+        Watch &entry = watches_[index];
+        std::shared_ptr<const Statistics> statistics(entry.statistics.lock());
+        if (!statistics)
+        {
+            entry = watches_.back();
+            watches_.pop_back();
+            continue;
+        }
+        ++index;
+
+        typename Clock::time_point since;
+        std::thread::id thread;
+        if (!statistics->running(since, thread) || now - since <= entry.budget)
+        {
+            continue;
+        }
+
+        Report report;
+        report.name = entry.name;
+        report.thread = thread;
+        report.duration = std::chrono::duration_cast<std::chrono::nanoseconds>(now - since);
+        report.budget = entry.budget;
+        blocked_.push_back(report);
+
+        if (entry.reported != since)
+        {
+            entry.reported = since;
+            ++reports_;
+            std::ostringstream message;
+            message << "Callback '" << entry.name << "' blocked on thread " << thread << " for "
+                    << std::chrono::duration_cast<std::chrono::milliseconds>(report.duration).count()
+                    << " ms, budget " << std::chrono::duration_cast<std::chrono::milliseconds>(entry.budget).count()
+                    << " ms";
+            messages.push_back(message.str());
+        }
+    }
+}
+
+typedef BasicCallbackWatchdog<std::chrono::steady_clock> CallbackWatchdog;
+}
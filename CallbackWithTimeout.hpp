@@ -21,28 +21,62 @@
 // SOFTWARE.
 #pragma once
 
+#include "Util/CallbackScheduler.hpp"
+#include "Util/CallbackStatistics.hpp"
+#include "Util/CallbackWatchdog.hpp"
+#include "Util/InplaceFunction.hpp"
+#include "Util/ManualClock.hpp"
+#include "Util/ScheduleOptions.hpp"
+#include "Util/ThreadOptions.hpp"
 #include <atomic>
 #include <chrono>
-#include <functional>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
 #include <mutex>
+#include <string>
 #include <thread>
+#include <utility>
+
+#if defined(__linux__)
+#include <sys/prctl.h>
+#endif
 
 namespace Util
 {
     /**
     *   \brief  CallbackWithTimeout serves thread safe callback executions.
+    *
+    *   \details  Runs on a dedicated thread by default, or as a lightweight
+    *             handle onto a shared CallbackScheduler. Clock is
+    *             std::chrono::steady_clock unless a test or benchmark
+    *             substitutes a ManualClock.
     */
-    template<class ParamType = void>
+    template<class ParamType = void, class Clock = std::chrono::steady_clock>
     class CallbackWithTimeout
     {
         typedef void(*CallbackFunction)(ParamType*);
+        typedef BasicCallbackScheduler<Clock> Scheduler;
+        typedef typename Scheduler::StatusCallback Callback;
+        typedef BasicCallbackStatistics<Clock> Statistics;
+        typedef BasicCallbackWatchdog<Clock> Watchdog;
 
     public:
         /**
          *  \brief Constructor
          */
         CallbackWithTimeout() noexcept
-            : execute_(false)
+            : execute_(false), scheduler_(nullptr), taskId_(0), watchdog_(nullptr)
+        {
+        }
+
+        /**
+         *  \brief Constructor of a handle running on a shared scheduler
+         *
+         *  \param [in] scheduler - a scheduler, must outlive this object
+         */
+        explicit CallbackWithTimeout(Scheduler& scheduler) noexcept
+            : execute_(false), scheduler_(&scheduler), taskId_(0), watchdog_(nullptr)
         {
         }
 
@@ -59,14 +93,66 @@ namespace Util
 
         /**
         *  \brief Stops thread execution
+        *
+        *  \details Waits for a running callback as long as it takes.
         */
         void stop() noexcept
         {
-            execute_.store(false, std::memory_order_release);
-            if( thread_.joinable() )
-            {
-                thread_.join();
-            }
+            stopWithin(nullptr);
+        }
+
+        /**
+        *  \brief Stops thread execution, waiting at most timeout for a running callback
+        *
+        *  \param [in] timeout - the longest wait for a blocked callback
+        *  \return SR_ABANDONED - if the callback is still blocked; its thread
+        *          is detached (or keeps its scheduler pool thread) and exits
+        *          once the callback returns, without calling it again
+        */
+        template<class Rep, class Period>
+        StopResult stop(const std::chrono::duration<Rep, Period>& timeout) noexcept
+        {
+            const std::chrono::nanoseconds wait(std::chrono::duration_cast<std::chrono::nanoseconds>(timeout));
+            return stopWithin(&wait);
+        }
+
+        /**
+        *  \brief Reports callbacks blocked longer than budget to a watchdog
+        *
+        *  \param [in] watchdog - a watchdog, must outlive this object
+        *  \param [in] name - a name to report the callback by
+        *  \param [in] budget - the longest acceptable callback call
+        *
+        *  \details Applied by the next start().
+        */
+        void setWatchdog(Watchdog& watchdog, const std::string& name,
+                         std::chrono::nanoseconds budget) noexcept
+        {
+            watchdog_ = &watchdog;
+            watchdogName_ = name;
+            watchdogBudget_ = budget;
+        }
+
+        /**
+        *  \brief Sets fixed delay/rate mode, overrun policy and alignment
+        *
+        *  \details Applied by the next start(); defaults to fixed delay.
+        */
+        void setScheduleOptions(const ScheduleOptions& options) noexcept
+        {
+            options_ = options;
+        }
+
+        /**
+        *  \brief Sets name, CPU affinity and scheduling policy of the thread
+        *
+        *  \details Applied by the next start() to the dedicated thread, best
+        *           effort (see applyThreadOptions). A shared scheduler takes
+        *           thread options for its whole pool instead.
+        */
+        void setThreadOptions(const ThreadOptions& options)
+        {
+            threadOptions_ = options;
         }
 
         /**
@@ -90,10 +176,72 @@ namespace Util
         *  \details Callback could be a blocking call. In cases callback blocked
         *           a thread guarantied running until the callback released.
         *           Note: Not advised to make a blocking callback!
+        *           On a shared scheduler the timeout is rounded up to the
+        *           scheduler resolution and a blocked callback holds one of
+        *           its pool threads.
         */
         void start(long long timeoutMilliseconds,
                    CallbackFunction callback,
                    ParamType* param) noexcept
+        {
+            this->start(std::chrono::milliseconds(timeoutMilliseconds), callback, param);
+        }
+
+        /**
+        *  \brief Starts immediate thread execution
+        *
+        *  \param [in] timeout - a timeout between callback calls, any precision
+        *  \param [in] callback - a callback function (static)
+        *  \param [in] param - a callback parameter
+        */
+        template<class Rep, class Period>
+        void start(const std::chrono::duration<Rep, Period>& timeout,
+                   CallbackFunction callback,
+                   ParamType* param) noexcept
+        {
+            this->start(timeout, [callback, param]() { callback(param); });
+        }
+
+        /**
+        *  \brief Starts immediate thread execution of a member function
+        *
+        *  \param [in] timeout - a timeout between callback calls, milliseconds or duration
+        *  \param [in] method - a member function
+        *  \param [in] object - an object to call the member function on
+        */
+        template<class Timeout, class Object>
+        void start(const Timeout& timeout, void (Object::*method)(), Object* object) noexcept
+        {
+            this->start(timeout, [method, object]() { (object->*method)(); });
+        }
+
+        /**
+        *  \brief Starts immediate thread execution of any callable
+        *
+        *  \param [in] timeoutMilliseconds - a timeout between callback calls
+        *  \param [in] callable - a lambda, functor or function taking no arguments
+        */
+        template<class Callable>
+        void start(long long timeoutMilliseconds, Callable&& callable) noexcept
+        {
+            this->start(std::chrono::milliseconds(timeoutMilliseconds),
+                        std::forward<Callable>(callable));
+        }
+
+        /**
+        *  \brief Starts immediate thread execution of any callable
+        *
+        *  \param [in] timeout - a timeout between callback calls, any precision
+        *  \param [in] callable - a lambda, functor or function taking no arguments
+        *
+        *  \details The callable is stored inline (see InplaceFunction), so its
+        *           captures never allocate. The thread waits for a steady clock
+        *           deadline, so stop() wakes it up immediately. A callable
+        *           returning a status (bool or std::future) backs off after
+        *           a failure as per ScheduleOptions::backoff.
+        */
+        template<class Rep, class Period, class Callable>
+        void start(const std::chrono::duration<Rep, Period>& timeout, Callable&& callable) noexcept
         {
             if( execute_.load(std::memory_order_acquire) )
             {
@@ -102,24 +250,79 @@ namespace Util
 
             execute_.store(true, std::memory_order_release);
 
-            thread_ = std::thread([this, timeoutMilliseconds, callback, param]()
+            if( scheduler_ )
             {
-                // Exits when stop flag is true
-                while (execute_.load(std::memory_order_acquire))
+                taskId_ = scheduler_->add(std::chrono::duration_cast<std::chrono::nanoseconds>(timeout),
+                                          std::forward<Callable>(callable),
+                                          options_);
+                if( watchdog_ )
                 {
-                    // Calls static executor-function
-                    callback(param);
-
-                    // Yield context switch and sleeps amount of milliseconds
-                    const long timeSliceMilliseconds(25);
-                    const long long maxSteps = timeoutMilliseconds / timeSliceMilliseconds;
-                    long step(0);
-                    while (execute_.load(std::memory_order_acquire) && step++ < maxSteps)
+                    watchdog_->watch(watchdogName_, scheduler_->statisticsOf(taskId_), watchdogBudget_);
+                }
+                return;
+            }
+
+            const typename Clock::duration period(
+                std::chrono::duration_cast<typename Clock::duration>(timeout));
+
+            // The thread owns its state, so an abandoned thread outlives this object safely
+            const ScheduleOptions options(options_);
+            const ThreadOptions threadOptions(threadOptions_);
+            const std::shared_ptr<Worker> worker(std::make_shared<Worker>());
+            worker->callback = makeStatusCallable(std::forward<Callable>(callable));
+            worker_ = worker;
+            if( watchdog_ )
+            {
+                watchdog_->watch(watchdogName_, worker->statistics, watchdogBudget_);
+            }
+
+            thread_ = std::thread([worker, period, options, threadOptions]()
+            {
+                applyThreadOptions(threadOptions);
+#if defined(__linux__)
+                // A dedicated thread has nobody to coalesce with but the kernel
+                if (options.slack.count() > 0)
+                {
+                    prctl(PR_SET_TIMERSLACK, static_cast<unsigned long>(options.slack.count()));
+                }
+#endif
+                std::unique_lock<std::mutex> lock(worker->mutex);
+                typename Clock::time_point deadline(firstDeadline(Clock::now(), period, options));
+                unsigned failures(0);
+                std::uint64_t random(reinterpret_cast<std::uintptr_t>(worker.get()) ^
+                                     static_cast<std::uint64_t>(deadline.time_since_epoch().count()));
+                random = random != 0 ? random : 1;
+
+                while (true)
+                {
+                    worker->nextFire.store(deadline.time_since_epoch().count(), std::memory_order_relaxed);
+
+                    // Sleeps until the deadline unless stop() wakes it up earlier
+                    ClockTraits<Clock>::waitUntil(worker->cv, lock, deadline, [&worker]()
+                    {
+                        return !worker->execute;
+                    });
+
+                    // Exits when stop flag is true
+                    if (!worker->execute)
                     {
-                        std::this_thread::sleep_for(
-                            std::chrono::milliseconds(timeSliceMilliseconds));
+                        break;
                     }
+
+                    // Calls executor-function
+                    lock.unlock();
+                    const typename Clock::time_point started(Clock::now());
+                    worker->statistics->begin(started);
+                    const bool succeeded(worker->callback());
+                    const typename Clock::time_point finished(Clock::now());
+                    worker->statistics->record(deadline, started, finished, period, succeeded);
+                    lock.lock();
+
+                    deadline = nextDeadline(deadline, finished, period, options, succeeded, failures, random);
                 }
+
+                worker->finished = true;
+                worker->cv.notify_all();
             });
         }
 
@@ -128,11 +331,116 @@ namespace Util
         */
         bool isRunning() const noexcept
         {
-            return (execute_.load(std::memory_order_acquire) && thread_.joinable());
+            return (execute_.load(std::memory_order_acquire) &&
+                    (scheduler_ ? taskId_ != 0 : thread_.joinable()));
+        }
+
+        /**
+        *  \brief Retrieves the deadline of the next callback call
+        *
+        *  \param [out] time - the deadline, later than the period while backing off
+        *  \return false - if not running
+        */
+        bool nextFireTime(typename Clock::time_point& time) const
+        {
+            if( !isRunning() )
+            {
+                return false;
+            }
+            if( scheduler_ )
+            {
+                return scheduler_->nextFireTime(taskId_, time);
+            }
+            time = typename Clock::time_point(
+                typename Clock::duration(worker_->nextFire.load(std::memory_order_relaxed)));
+            return true;
+        }
+
+        /**
+        *  \brief Retrieves callback execution time, lateness and overrun statistics
+        *
+        *  \details Counters restart with every start().
+        */
+        typename Statistics::Snapshot statistics() const
+        {
+            typename Statistics::Snapshot snapshot = typename Statistics::Snapshot();
+            if( scheduler_ && taskId_ != 0 )
+            {
+                scheduler_->statistics(taskId_, snapshot);
+            }
+            else if( worker_ )
+            {
+                snapshot = worker_->statistics->snapshot();
+            }
+            return snapshot;
+        }
+
+    private:
+        /**
+        *  \brief State of a dedicated thread, shared with the thread itself
+        */
+        struct Worker
+        {
+            Worker()
+                : execute(true), finished(false), statistics(std::make_shared<Statistics>()),
+                  nextFire(0)
+            {
+            }
+
+            bool execute;
+            bool finished;
+            Callback callback;
+            std::shared_ptr<Statistics> statistics;
+            std::atomic<typename Clock::rep> nextFire;
+            std::mutex mutex;
+            std::condition_variable cv;
+        };
+
+        StopResult stopWithin(const std::chrono::nanoseconds* timeout) noexcept
+        {
+            StopResult result(SR_STOPPED);
+            execute_.store(false, std::memory_order_release);
+            if( scheduler_ )
+            {
+                if( timeout )
+                {
+                    result = scheduler_->remove(taskId_, *timeout);
+                }
+                else
+                {
+                    scheduler_->remove(taskId_);
+                }
+                taskId_ = 0;
+            }
+            if( worker_ )
+            {
+                std::unique_lock<std::mutex> lock(worker_->mutex);
+                worker_->execute = false;
+                worker_->cv.notify_all();
+                if( timeout && thread_.joinable() &&
+                    !worker_->cv.wait_for(lock, *timeout, [this]() { return worker_->finished; }) )
+                {
+                    thread_.detach();
+                    result = SR_ABANDONED;
+                }
+            }
+            if( thread_.joinable() )
+            {
+                thread_.join();
+            }
+            return result;
         }
 
     private:
         std::atomic<bool> execute_;
         std::thread thread_;
+        std::shared_ptr<Worker> worker_;
+        ScheduleOptions options_;
+        ThreadOptions threadOptions_;
+        Scheduler* scheduler_;
+        typename Scheduler::TaskId taskId_;
+        Watchdog* watchdog_;
+        std::string watchdogName_;
+        std::chrono::nanoseconds watchdogBudget_;
     };
 }
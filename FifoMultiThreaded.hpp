@@ -37,6 +37,7 @@ class FifoMultiThreaded
 {
   public:
     FifoMultiThreaded();
+    explicit FifoMultiThreaded(const A &container);
     virtual ~FifoMultiThreaded();
 
     bool push(const T &element);
@@ -60,6 +61,16 @@ FifoMultiThreaded<T, A>::FifoMultiThreaded()
 {
 }
 
+/**
+*  \brief Constructs the queue over a prepared container, e.g. one whose
+*         allocator binds storage to a NUMA node (see NumaAllocator.hpp)
+*/
+template <class T, class A>
+FifoMultiThreaded<T, A>::FifoMultiThreaded(const A &container)
+    : queue_(container)
+{
+}
+
 template <class T, class A>
 FifoMultiThreaded<T, A>::~FifoMultiThreaded()
 {
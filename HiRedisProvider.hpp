@@ -14,7 +14,9 @@
 #include "Util/IPairWrittable.hpp"
 #include "Util/ILogProvider.hpp"
 #include <hiredis.h> // redis client
+#include <iterator>
 #include <mutex>
+#include <vector>
 
 static const std::string REDIS_HOST("127.0.0.1");
 static const int REDIS_PORT(6379);
@@ -58,6 +60,7 @@ class HiRedisProvider : public IPairWrittable
                 loggerRef_.error("Failed to connect to redis server, error: " +
                                  std::string(connContext_->errstr));
                 redisFree(connContext_);
+                connContext_ = nullptr;
             }
             else
             {
@@ -67,6 +70,9 @@ class HiRedisProvider : public IPairWrittable
     }
 
   public:
+    using IPairWrittable::getValue;
+    using IPairWrittable::setValue;
+
     virtual ~HiRedisProvider()
     {
         if (isConnected())
@@ -115,12 +121,22 @@ class HiRedisProvider : public IPairWrittable
         {
             std::lock_guard<std::recursive_mutex> guard(connContextMutex_);
 
-            void *replyRawObj = redisCommand(connContext_, "SET %s %s", key.c_str(), value.c_str());
+            void *replyRawObj = redisCommand(connContext_, "SET %b %b", key.data(), key.size(), value.data(),
+                                             value.size());
             redisReply *replyObj = reinterpret_cast<redisReply *>(replyRawObj);
-            loggerRef_.trace(std::string("Redis replied for SET ") + key + std::string(" ") + value +
-                             std::string(": ") + (replyObj->str ? replyObj->str : std::string()));
+            if (replyObj == nullptr)
+            {
+                loggerRef_.error("Redis failed SET: " + std::string(connContext_->errstr));
+                return false;
+            }
+            // Values are binary, log their size only
+            loggerRef_.trace(std::string("Redis replied for SET ") + key + std::string(" (") +
+                             std::to_string(value.size()) + std::string(" bytes): ") +
+                             (replyObj->type == REDIS_REPLY_STATUS || replyObj->type == REDIS_REPLY_ERROR
+                                  ? std::string(replyObj->str, replyObj->len)
+                                  : std::string()));
+            status = replyObj->type != REDIS_REPLY_ERROR;
             freeReplyObject(replyObj);
-            status = true;
         }
         else
         {
@@ -129,6 +145,273 @@ class HiRedisProvider : public IPairWrittable
         return status;
     }
 
+    /**
+     * @brief Retrieves a value by an exact key into the caller's string,
+     *        passing the key to redis as is (binary safe, no copy).
+     *
+     * @param [in] key - a key, not necessarily null terminated
+     * @param [in] keyLength - the key length
+     * @param [out] value - a value, its capacity is reused
+     * @return true - if key found
+     * @return false - if key not found
+     */
+    bool getValue(const char *key, std::size_t keyLength, std::string &value) override
+    {
+        value.clear();
+        if (isConnected() && keyLength > 0)
+        {
+            const char *argv[2] = {"GET", key};
+            const size_t argvLen[2] = {3, keyLength};
+
+            std::lock_guard<std::recursive_mutex> guard(connContextMutex_);
+            void *replyRawObj = redisCommandArgv(connContext_, 2, argv, argvLen);
+            redisReply *replyObj = reinterpret_cast<redisReply *>(replyRawObj);
+            if (replyObj == nullptr)
+            {
+                loggerRef_.error("Redis failed GET: " + std::string(connContext_->errstr));
+                return false;
+            }
+            if (replyObj->type == REDIS_REPLY_STRING)
+            {
+                value.assign(replyObj->str, replyObj->len);
+            }
+            freeReplyObject(replyObj); // no trace: it would build strings on every lookup
+        }
+        return !value.empty();
+    }
+
+    /**
+     * @brief Sets value for a key without temporary strings (binary safe).
+     *
+     * @return true - if succeded, false - otherwise
+     */
+    bool setValue(const char *key, std::size_t keyLength, const char *value, std::size_t valueLength) override
+    {
+        if (!isConnected())
+        {
+            loggerRef_.error("Redis is not connected! Cannot set any values!");
+            return false;
+        }
+
+        const char *argv[3] = {"SET", key, value};
+        const size_t argvLen[3] = {3, keyLength, valueLength};
+
+        std::lock_guard<std::recursive_mutex> guard(connContextMutex_);
+        void *replyRawObj = redisCommandArgv(connContext_, 3, argv, argvLen);
+        redisReply *replyObj = reinterpret_cast<redisReply *>(replyRawObj);
+        if (replyObj == nullptr)
+        {
+            loggerRef_.error("Redis failed SET: " + std::string(connContext_->errstr));
+            return false;
+        }
+        const bool status(replyObj->type != REDIS_REPLY_ERROR);
+        freeReplyObject(replyObj);
+        return status;
+    }
+
+    /**
+     * @brief Retrieves values of many exact keys in one MGET round-trip.
+     *
+     * @param [in] keys - exact keys (no "\*" notation)
+     * @param [out] values - values[i] is the value of keys[i], empty if not found
+     * @return true - if all keys found
+     * @return false - if any key not found
+     */
+    bool getValues(const std::vector<std::string> &keys, std::vector<std::string> &values) override
+    {
+        resetValues(values, keys.size());
+        if (keys.empty())
+        {
+            return true;
+        }
+        if (!isConnected())
+        {
+            loggerRef_.error("Redis is not connected! Cannot get any values!");
+            return false;
+        }
+
+        std::vector<const char *> argv;
+        std::vector<size_t> argvLen;
+        argv.reserve(keys.size() + 1);
+        argvLen.reserve(keys.size() + 1);
+        argv.push_back("MGET");
+        argvLen.push_back(4);
+        for (const std::string &key : keys)
+        {
+            argv.push_back(key.c_str());
+            argvLen.push_back(key.size());
+        }
+
+        std::lock_guard<std::recursive_mutex> guard(connContextMutex_);
+        void *replyRawObj = redisCommandArgv(connContext_, static_cast<int>(argv.size()), argv.data(), argvLen.data());
+        redisReply *replyObj = reinterpret_cast<redisReply *>(replyRawObj);
+        if (replyObj == nullptr)
+        {
+            loggerRef_.error("Redis failed MGET: " + std::string(connContext_->errstr));
+            return false;
+        }
+
+        bool found(replyObj->type == REDIS_REPLY_ARRAY && replyObj->elements == keys.size());
+        for (size_t index = 0; found && index < replyObj->elements; ++index)
+        {
+            const redisReply *element = replyObj->element[index];
+            if (element->type == REDIS_REPLY_STRING && element->len > 0)
+            {
+                values[index].assign(element->str, element->len);
+            }
+        }
+        for (size_t index = 0; index < values.size(); ++index)
+        {
+            found = found && !values[index].empty();
+        }
+        loggerRef_.trace(std::string("Redis replied for MGET of ") + std::to_string(keys.size()) +
+                         std::string(" keys: returns elements: ") + std::to_string(replyObj->elements));
+        freeReplyObject(replyObj);
+        return found;
+    }
+
+    /**
+     * @brief Sets many values in one MSET round-trip.
+     *
+     * @param pairs - keys and values
+     * @return true - if succeded, false - otherwise
+     */
+    bool setValues(const std::vector<KeyValuePair> &pairs) override
+    {
+        if (pairs.empty())
+        {
+            return true;
+        }
+        if (!isConnected())
+        {
+            loggerRef_.error("Redis is not connected! Cannot set any values!");
+            return false;
+        }
+
+        std::vector<const char *> argv;
+        std::vector<size_t> argvLen;
+        argv.reserve(pairs.size() * 2 + 1);
+        argvLen.reserve(pairs.size() * 2 + 1);
+        argv.push_back("MSET");
+        argvLen.push_back(4);
+        for (const KeyValuePair &pair : pairs)
+        {
+            argv.push_back(pair.key.c_str());
+            argvLen.push_back(pair.key.size());
+            argv.push_back(pair.value.c_str());
+            argvLen.push_back(pair.value.size());
+        }
+
+        std::lock_guard<std::recursive_mutex> guard(connContextMutex_);
+        void *replyRawObj = redisCommandArgv(connContext_, static_cast<int>(argv.size()), argv.data(), argvLen.data());
+        redisReply *replyObj = reinterpret_cast<redisReply *>(replyRawObj);
+        if (replyObj == nullptr)
+        {
+            loggerRef_.error("Redis failed MSET: " + std::string(connContext_->errstr));
+            return false;
+        }
+
+        const bool status(replyObj->type != REDIS_REPLY_ERROR);
+        loggerRef_.trace(std::string("Redis replied for MSET of ") + std::to_string(pairs.size()) +
+                         std::string(" pairs: ") + (replyObj->str ? replyObj->str : std::string()));
+        freeReplyObject(replyObj);
+        return status;
+    }
+
+    /**
+     * @brief Streams key/value pairs of a "\*" key page by page: SCAN MATCH
+     *        fetches the next keys, MGET their values, so memory stays
+     *        bounded however many keys match. As with SCAN, keys changed
+     *        meanwhile may be missed or visited twice.
+     *
+     * @param [in] key - a key (can have "\*" notation, e.g. "printer/terminal/\*")
+     * @param [in] pageSize - the most pairs per page, also the SCAN COUNT hint
+     * @param [in] visitor - called per page without the connection locked, returns false to stop
+     * @return true - if key found
+     * @return false - if key not found
+     */
+    bool visitPages(const std::string &key, std::size_t pageSize, const PageVisitor &visitor) override
+    {
+        if (key.empty() || '*' != key.back())
+        {
+            return IPairWrittable::visitPages(key, pageSize, visitor);
+        }
+        if (!isConnected())
+        {
+            loggerRef_.error("Redis is not connected! Cannot get any values!");
+            return false;
+        }
+
+        const std::size_t limit(pageSize > 0 ? pageSize : 1);
+        const std::string count(std::to_string(limit));
+        std::string cursor("0");
+        std::vector<std::string> scanned;
+        std::vector<std::string> keys;
+        std::vector<std::string> values;
+        std::vector<KeyValuePair> page;
+        bool found(false);
+        do
+        {
+            scanned.clear();
+            {
+                const char *argv[6] = {"SCAN", cursor.c_str(), "MATCH", key.c_str(), "COUNT", count.c_str()};
+                const size_t argvLen[6] = {4, cursor.size(), 5, key.size(), 5, count.size()};
+
+                std::lock_guard<std::recursive_mutex> guard(connContextMutex_);
+                void *replyRawObj = redisCommandArgv(connContext_, 6, argv, argvLen);
+                redisReply *replyObj = reinterpret_cast<redisReply *>(replyRawObj);
+                if (replyObj == nullptr)
+                {
+                    loggerRef_.error("Redis failed SCAN: " + std::string(connContext_->errstr));
+                    return found;
+                }
+                if (replyObj->type == REDIS_REPLY_ARRAY && replyObj->elements == 2 &&
+                    replyObj->element[1]->type == REDIS_REPLY_ARRAY)
+                {
+                    cursor.assign(replyObj->element[0]->str, replyObj->element[0]->len);
+                    const redisReply *batch = replyObj->element[1];
+                    for (size_t index = 0; index < batch->elements; ++index)
+                    {
+                        scanned.push_back(std::string(batch->element[index]->str, batch->element[index]->len));
+                    }
+                }
+                else
+                {
+                    loggerRef_.error("Redis replied for SCAN " + key + " with an unexpected reply");
+                    cursor = "0";
+                }
+                freeReplyObject(replyObj);
+            }
+
+            // COUNT is a hint only: page what SCAN returned
+            for (std::size_t begin = 0; begin < scanned.size(); begin += limit)
+            {
+                const std::size_t end(begin + limit < scanned.size() ? begin + limit : scanned.size());
+                keys.assign(std::make_move_iterator(scanned.begin() + begin),
+                            std::make_move_iterator(scanned.begin() + end));
+                getValues(keys, values);
+
+                page.clear();
+                for (std::size_t index = 0; index < keys.size(); ++index)
+                {
+                    if (!values[index].empty())
+                    {
+                        page.push_back(KeyValuePair(std::move(keys[index]), std::move(values[index])));
+                    }
+                }
+                if (!page.empty())
+                {
+                    found = true;
+                    if (!visitor(page))
+                    {
+                        return found;
+                    }
+                }
+            }
+        } while (cursor != "0");
+        return found;
+    }
+
   protected:
     /**
      * @brief Validates if redis connection opened?
@@ -150,17 +433,30 @@ class HiRedisProvider : public IPairWrittable
      * @return true - if key found
      * @return false - if key not found
      */
-    bool getValue(const std::string &key, std::string &value)
+    bool fetchValue(const std::string &key, std::string &value)
     {
         if (isConnected() && !key.empty())
         {
             std::lock_guard<std::recursive_mutex> guard(connContextMutex_);
 
-            void *replyRawObj = redisCommand(connContext_, "GET %s", key.c_str());
+            void *replyRawObj = redisCommand(connContext_, "GET %b", key.data(), key.size());
             redisReply *replyObj = reinterpret_cast<redisReply *>(replyRawObj);
-            value.assign(replyObj->str ? replyObj->str : std::string());
+            if (replyObj == nullptr)
+            {
+                loggerRef_.error("Redis failed GET: " + std::string(connContext_->errstr));
+                value.clear();
+                return false;
+            }
+            if (replyObj->type == REDIS_REPLY_STRING)
+            {
+                value.assign(replyObj->str, replyObj->len);
+            }
+            else
+            {
+                value.clear();
+            }
             loggerRef_.trace(std::string("Redis replied for GET ") + key +
-                             std::string(": ") + value);
+                             std::string(": ") + std::to_string(value.size()) + std::string(" bytes"));
             freeReplyObject(replyObj);
         }
         return !value.empty();
@@ -195,7 +491,7 @@ class HiRedisProvider : public IPairWrittable
             if ('*' != key.back()) // single key
             {
                 std::string value;
-                if (getValue(key, value))
+                if (fetchValue(key, value))
                 {
                     values.push_back(callback(key, value));
                 }
@@ -204,15 +500,20 @@ class HiRedisProvider : public IPairWrittable
             {
                 std::lock_guard<std::recursive_mutex> guard(connContextMutex_);
 
-                void *replyRawObj = redisCommand(connContext_, "KEYS %s", key.c_str());
+                void *replyRawObj = redisCommand(connContext_, "KEYS %b", key.data(), key.size());
                 redisReply *replyObj = reinterpret_cast<redisReply *>(replyRawObj);
+                if (replyObj == nullptr)
+                {
+                    loggerRef_.error("Redis failed KEYS: " + std::string(connContext_->errstr));
+                    return false;
+                }
                 loggerRef_.trace(std::string("Redis replied for KEYS ") + key +
                                  std::string(": returns elements: ") + std::to_string(replyObj->elements));
                 for (size_t index = 0; index < replyObj->elements; ++index)
                 {
-                    std::string subkey(replyObj->element[index]->str);
+                    std::string subkey(replyObj->element[index]->str, replyObj->element[index]->len);
                     std::string value;
-                    if (getValue(subkey, value))
+                    if (fetchValue(subkey, value))
                     {
                         values.push_back(callback(subkey, value));
                     }
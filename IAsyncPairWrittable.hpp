@@ -0,0 +1,79 @@
+// MIT License
+// 
+// Copyright(c) 2018 Alex Tversky
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#pragma once
+
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+
+namespace Util
+{
+/**
+ * @brief Asynchronous companion of IPairWrittable: requests return at once,
+ *        completions arrive through a callback or a future.
+ *
+ */
+class IAsyncPairWrittable
+{
+  public:
+    typedef std::function<void(bool found, const std::string &value)> GetCallback;
+    typedef std::function<void(bool status)> SetCallback;
+
+    virtual ~IAsyncPairWrittable() {}
+
+    virtual void getValueAsync(const std::string &key, GetCallback callback) = 0;
+    virtual void setValueAsync(const std::string &key, const std::string &value, SetCallback callback) = 0;
+
+    inline std::future<std::string> getValueAsync(const std::string &key);
+    inline std::future<bool> setValueAsync(const std::string &key, const std::string &value);
+};
+
+/**
+ * @brief Retrieves a value by an exact key, as a future
+ *
+ * @param [in] key - a key
+ * @return a future of the value, empty if not found
+ */
+std::future<std::string> IAsyncPairWrittable::getValueAsync(const std::string &key)
+{
+    std::shared_ptr<std::promise<std::string>> promise(std::make_shared<std::promise<std::string>>());
+    std::future<std::string> result(promise->get_future());
+    getValueAsync(key, [promise](bool found, const std::string &value) {
+        promise->set_value(found ? value : std::string());
+    });
+    return result;
+}
+
+/**
+ * @brief Sets value for given key, as a future
+ *
+ * @return a future of true - if succeded, false - otherwise
+ */
+std::future<bool> IAsyncPairWrittable::setValueAsync(const std::string &key, const std::string &value)
+{
+    std::shared_ptr<std::promise<bool>> promise(std::make_shared<std::promise<bool>>());
+    std::future<bool> result(promise->get_future());
+    setValueAsync(key, value, [promise](bool status) { promise->set_value(status); });
+    return result;
+}
+}
@@ -21,9 +21,19 @@
 // SOFTWARE.
 #pragma once
 
+#include <cstring>
+#include <functional>
+#include <iterator>
 #include <string>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+#if __cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L)
+#include <string_view>
+#define UTIL_HAS_STRING_VIEW 1
+#endif
+
 namespace Util
 {
 
@@ -34,7 +44,7 @@ struct KeyValuePair {
     std::string key;
     std::string value;
 
-    KeyValuePair(std::string k, std::string v) : key(k), value(v) {}
+    KeyValuePair(std::string k, std::string v) : key(std::move(k)), value(std::move(v)) {}
 };
 
 /**
@@ -44,10 +54,195 @@ struct KeyValuePair {
 class IPairWrittable
 {
   public:
+    typedef std::function<bool(std::vector<KeyValuePair> &page)> PageVisitor; // false stops
+    typedef std::function<bool(const KeyValuePair &pair)> Visitor;            // false stops
+
     virtual ~IPairWrittable() {}
 
     virtual bool getKeyValue(const std::string &key, std::vector<KeyValuePair> &values) = 0;
     virtual bool getValue(const std::string &key, std::vector<std::string> &values) = 0;
     virtual bool setValue(const std::string &key, const std::string &value) = 0;
+
+    virtual bool getValues(const std::vector<std::string> &keys, std::vector<std::string> &values);
+    virtual bool setValues(const std::vector<KeyValuePair> &pairs);
+
+    virtual bool getValue(const char *key, std::size_t keyLength, std::string &value);
+    virtual bool setValue(const char *key, std::size_t keyLength, const char *value, std::size_t valueLength);
+
+    virtual bool visitPages(const std::string &key, std::size_t pageSize, const PageVisitor &visitor);
+
+    bool visit(const std::string &key, const Visitor &visitor, std::size_t pageSize = 256)
+    {
+        return visitPages(key, pageSize, [&visitor](std::vector<KeyValuePair> &page) {
+            for (const KeyValuePair &pair : page)
+            {
+                if (!visitor(pair))
+                {
+                    return false;
+                }
+            }
+            return true;
+        });
+    }
+
+    bool getValue(const char *key, std::string &value)
+    {
+        return getValue(key, std::strlen(key), value);
+    }
+
+    bool getValue(const std::string &key, std::string &value)
+    {
+        return getValue(key.data(), key.size(), value);
+    }
+
+#if defined(UTIL_HAS_STRING_VIEW)
+    // Templates taking std::string_view only, so literals and std::string
+    // keep resolving to the overloads above without ambiguity
+    template <class View,
+              class = typename std::enable_if<std::is_same<View, std::string_view>::value>::type>
+    bool getValue(View key, std::string &value)
+    {
+        return getValue(key.data(), key.size(), value);
+    }
+
+    template <class KeyView, class ValueView,
+              class = typename std::enable_if<std::is_same<KeyView, std::string_view>::value &&
+                                              std::is_same<ValueView, std::string_view>::value>::type>
+    bool setValue(KeyView key, ValueView value)
+    {
+        return setValue(key.data(), key.size(), value.data(), value.size());
+    }
+#endif
+
+  protected:
+    static void resetValues(std::vector<std::string> &values, std::size_t count);
 };
+
+/**
+ * @brief Retrieves values of many exact keys at once.
+ *        Default one getValue() per key, providers override it natively.
+ *
+ * @param [in] keys - exact keys ("\*" notation is not expanded)
+ * @param [out] values - values[i] is the value of keys[i], empty if not found
+ * @return true - if all keys found
+ * @return false - if any key not found
+ */
+inline bool IPairWrittable::getValues(const std::vector<std::string> &keys, std::vector<std::string> &values)
+{
+    bool found(true);
+    resetValues(values, keys.size());
+    std::vector<std::string> single;
+    for (std::size_t index = 0; index < keys.size(); ++index)
+    {
+        if (getValue(keys[index], single) && !single.empty())
+        {
+            values[index].assign(single[0]);
+        }
+        else
+        {
+            found = false;
+        }
+    }
+    return found;
+}
+
+/**
+ * @brief Sets many values at once.
+ *        Default one setValue() per pair, providers override it natively.
+ *
+ * @param pairs - keys and values
+ * @return true - if all values set, false - otherwise
+ */
+inline bool IPairWrittable::setValues(const std::vector<KeyValuePair> &pairs)
+{
+    bool status(true);
+    for (const KeyValuePair &pair : pairs)
+    {
+        status = setValue(pair.key, pair.value) && status;
+    }
+    return status;
+}
+
+/**
+ * @brief Retrieves a single value by an exact key, without a temporary key string.
+ *        The value is written into the caller's string, so a reused string
+ *        stops allocating once its capacity suffices. Default calls
+ *        getValue() with a copy of the key, providers override it natively.
+ *
+ * @param [in] key - a key, not necessarily null terminated
+ * @param [in] keyLength - the key length
+ * @param [out] value - a value, empty if not found
+ * @return true - if key found
+ * @return false - if key not found
+ */
+inline bool IPairWrittable::getValue(const char *key, std::size_t keyLength, std::string &value)
+{
+    std::vector<std::string> values;
+    value.clear();
+    if (getValue(std::string(key, keyLength), values) && !values.empty())
+    {
+        value.assign(values[0]);
+    }
+    return !value.empty();
+}
+
+/**
+ * @brief Sets value for a key, without temporary strings in native providers.
+ *        Default calls setValue() with copies.
+ *
+ * @return true - if succeded, false - otherwise
+ */
+inline bool IPairWrittable::setValue(const char *key, std::size_t keyLength,
+                                     const char *value, std::size_t valueLength)
+{
+    return setValue(std::string(key, keyLength), std::string(value, valueLength));
+}
+
+/**
+ * @brief Streams key/value pairs of a key in pages of at most pageSize pairs,
+ *        so a "\*" lookup with many matches needs no memory for all of them.
+ *        Default pages the result of getKeyValue(), providers override it
+ *        natively. The visitor may take the pairs out of the page.
+ *
+ * @param [in] key - a key (can have "\*" notation, e.g. "printer/terminal/\*")
+ * @param [in] pageSize - the most pairs per page
+ * @param [in] visitor - called per page, returns false to stop
+ * @return true - if key found
+ * @return false - if key not found
+ */
+inline bool IPairWrittable::visitPages(const std::string &key, std::size_t pageSize, const PageVisitor &visitor)
+{
+    std::vector<KeyValuePair> pairs;
+    if (!getKeyValue(key, pairs))
+    {
+        return false;
+    }
+
+    const std::size_t limit(pageSize > 0 ? pageSize : 1);
+    std::vector<KeyValuePair> page;
+    for (std::size_t begin = 0; begin < pairs.size(); begin += limit)
+    {
+        const std::size_t end(begin + limit < pairs.size() ? begin + limit : pairs.size());
+        page.clear();
+        page.insert(page.end(), std::make_move_iterator(pairs.begin() + begin),
+                    std::make_move_iterator(pairs.begin() + end));
+        if (!visitor(page))
+        {
+            break;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Sizes and empties an output vector, keeping the capacity of its strings
+ */
+inline void IPairWrittable::resetValues(std::vector<std::string> &values, std::size_t count)
+{
+    values.resize(count);
+    for (std::string &value : values)
+    {
+        value.clear();
+    }
+}
 }
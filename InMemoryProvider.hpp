@@ -0,0 +1,599 @@
+// MIT License
+// 
+// Copyright(c) 2018 Alex Tversky
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#pragma once
+
+#include "Util/IPairWrittable.hpp"
+#include "Util/RadixIndex.hpp"
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace Util
+{
+/**
+ *  \brief InMemoryProvider - IPairWrittable over a concurrent in-process hash map
+ *
+ *  \details An open-addressing table of atomic pointers to immutable nodes.
+ *           Readers take no locks: they announce themselves in a per-thread
+ *           epoch counter, probe the table and copy what they find. Writers
+ *           lock one of 64 stripes by key hash, then publish a new node with
+ *           CAS (new key) or exchange (new value); replaced nodes and
+ *           outgrown tables are freed once no reader of their epoch is left.
+ *           The table doubles when half full, briefly locking all stripes.
+ *           Keys ending with "\*" match all keys with that prefix, like
+ *           KEYS in HiRedisProvider, found through a RadixIndex of keys in
+ *           time of the prefix plus the matches; adding a new key locks the
+ *           index briefly. An empty value reads as not found.
+ */
+class InMemoryProvider : public IPairWrittable
+{
+  public:
+    using IPairWrittable::getValue;
+    using IPairWrittable::setValue;
+
+    explicit InMemoryProvider(std::size_t capacity = 1024);
+    virtual ~InMemoryProvider();
+
+    bool getKeyValue(const std::string &key, std::vector<KeyValuePair> &values) override;
+    bool getValue(const std::string &key, std::vector<std::string> &values) override;
+    bool setValue(const std::string &key, const std::string &value) override;
+    bool getValues(const std::vector<std::string> &keys, std::vector<std::string> &values) override;
+    bool getValue(const char *key, std::size_t keyLength, std::string &value) override;
+    bool setValue(const char *key, std::size_t keyLength, const char *value, std::size_t valueLength) override;
+    bool visitPages(const std::string &key, std::size_t pageSize, const PageVisitor &visitor) override;
+
+    std::size_t size() const;
+
+  private:
+    InMemoryProvider(const InMemoryProvider &other) = delete;
+    InMemoryProvider(const InMemoryProvider &&other) = delete;
+    InMemoryProvider &operator=(const InMemoryProvider &other) = delete;
+    InMemoryProvider &operator=(const InMemoryProvider &&other) = delete;
+
+    static const unsigned writeStripes = 64;
+    static const unsigned readerSlots = 64;
+    static const unsigned reclaimPeriod = 64; // retirements between reclamation attempts
+
+    struct Node
+    {
+        std::uint64_t hash;
+        std::string key;
+        std::string value;
+    };
+
+    struct Table
+    {
+        explicit Table(std::size_t capacity);
+
+        std::size_t mask;
+        std::unique_ptr<std::atomic<Node *>[]> slots;
+    };
+
+    struct ReaderSlot
+    {
+        std::atomic<std::uint64_t> active[3]; // readers per epoch modulo 3
+        char padding[64 - 3 * sizeof(std::atomic<std::uint64_t>)]; // one cache line per slot
+    };
+
+    struct Retired
+    {
+        void *pointer;
+        void (*destroy)(void *);
+        std::uint64_t epoch;
+    };
+
+    /**
+     *  \brief Keeps nodes and tables seen by the reader alive
+     */
+    class ReadGuard
+    {
+      public:
+        explicit ReadGuard(InMemoryProvider &owner);
+        ~ReadGuard();
+
+      private:
+        std::atomic<std::uint64_t> *counter_;
+    };
+
+    static std::uint64_t hashOf(const char *key, std::size_t length);
+    static unsigned readerSlot();
+    static void destroyNode(void *node);
+    static void destroyTable(void *table);
+
+    const Node *find(std::uint64_t hash, const char *key, std::size_t length) const;
+    template <class NodeVisitor>
+    void scan(const std::string &prefix, NodeVisitor visit) const;
+    void grow();
+    void retire(void *pointer, void (*destroy)(void *));
+    void reclaim();
+
+  private:
+    std::atomic<Table *> table_;
+    RadixIndex index_; // all non-empty keys, never shrinks as keys are never removed
+    mutable std::mutex indexMutex_;
+    std::atomic<std::size_t> size_;
+    std::mutex writeMutexes_[writeStripes];
+    std::atomic<std::uint64_t> epoch_;
+    ReaderSlot readers_[readerSlots];
+    std::mutex retiredMutex_;
+    std::vector<Retired> retired_;
+    unsigned retiredSinceReclaim_;
+};
+
+inline InMemoryProvider::Table::Table(std::size_t capacity) : mask(capacity - 1), slots(new std::atomic<Node *>[capacity])
+{
+    for (std::size_t index = 0; index < capacity; ++index)
+    {
+        slots[index].store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+inline InMemoryProvider::ReadGuard::ReadGuard(InMemoryProvider &owner)
+{
+    ReaderSlot &slot = owner.readers_[readerSlot()];
+    for (;;)
+    {
+        const std::uint64_t epoch(owner.epoch_.load());
+        counter_ = &slot.active[epoch % 3];
+        counter_->fetch_add(1);
+        if (owner.epoch_.load() == epoch)
+        {
+            break; // announced in the current epoch
+        }
+        counter_->fetch_sub(1);
+    }
+}
+
+inline InMemoryProvider::ReadGuard::~ReadGuard()
+{
+    counter_->fetch_sub(1, std::memory_order_release);
+}
+
+/**
+ * @brief Constructor
+ *
+ * @param capacity - initial number of slots (rounded up to a power of two), grows as needed
+ */
+inline InMemoryProvider::InMemoryProvider(std::size_t capacity) : size_(0), epoch_(0), retiredSinceReclaim_(0)
+{
+    std::size_t slots(4 * writeStripes); // stripes may overshoot the growth threshold concurrently
+    while (slots < capacity)
+    {
+        slots <<= 1;
+    }
+    table_.store(new Table(slots));
+    for (ReaderSlot &slot : readers_)
+    {
+        for (std::atomic<std::uint64_t> &counter : slot.active)
+        {
+            counter.store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+inline InMemoryProvider::~InMemoryProvider()
+{
+    Table *table = table_.load();
+    for (std::size_t index = 0; index <= table->mask; ++index)
+    {
+        delete table->slots[index].load(std::memory_order_relaxed);
+    }
+    delete table;
+    for (const Retired &retired : retired_)
+    {
+        retired.destroy(retired.pointer);
+    }
+}
+
+/**
+ * @brief Retrieves value/s by key, as Key/Value pairs
+ *
+ * @param [in] key - a key (can have "\*" notation, e.g. "printer/terminal/\*")
+ * @param [out] values - a single or multiple values
+ * @return true - if key found
+ * @return false - if key not found
+ */
+inline bool InMemoryProvider::getKeyValue(const std::string &key, std::vector<KeyValuePair> &values)
+{
+    values.clear();
+    if (key.empty())
+    {
+        return false;
+    }
+
+    ReadGuard guard(*this);
+    if ('*' == key.back())
+    {
+        scan(key.substr(0, key.size() - 1),
+             [&values](const Node &node) {
+                 values.push_back(KeyValuePair(node.key, node.value));
+                 return true;
+             });
+    }
+    else
+    {
+        const Node *node = find(hashOf(key.data(), key.size()), key.data(), key.size());
+        if (node != nullptr && !node->value.empty())
+        {
+            values.push_back(KeyValuePair(node->key, node->value));
+        }
+    }
+    return !values.empty();
+}
+
+/**
+ * @brief Retrieves value/s by key.
+ *
+ * @param [in] key - a key (can have "\*" notation, e.g. "printer/terminal/\*")
+ * @param [out] values - a single or multiple values
+ * @return true - if key found
+ * @return false - if key not found
+ */
+inline bool InMemoryProvider::getValue(const std::string &key, std::vector<std::string> &values)
+{
+    values.clear();
+    if (key.empty())
+    {
+        return false;
+    }
+
+    ReadGuard guard(*this);
+    if ('*' == key.back())
+    {
+        scan(key.substr(0, key.size() - 1), [&values](const Node &node) {
+            values.push_back(node.value);
+            return true;
+        });
+    }
+    else
+    {
+        const Node *node = find(hashOf(key.data(), key.size()), key.data(), key.size());
+        if (node != nullptr && !node->value.empty())
+        {
+            values.push_back(node->value);
+        }
+    }
+    return !values.empty();
+}
+
+/**
+ * @brief Retrieves a value by an exact key into the caller's string, lock-free
+ */
+inline bool InMemoryProvider::getValue(const char *key, std::size_t keyLength, std::string &value)
+{
+    ReadGuard guard(*this);
+    const Node *node = find(hashOf(key, keyLength), key, keyLength);
+    if (node != nullptr)
+    {
+        value.assign(node->value);
+    }
+    else
+    {
+        value.clear();
+    }
+    return !value.empty();
+}
+
+/**
+ * @brief Retrieves values of many exact keys under one read guard
+ */
+inline bool InMemoryProvider::getValues(const std::vector<std::string> &keys, std::vector<std::string> &values)
+{
+    bool found(true);
+    resetValues(values, keys.size());
+    ReadGuard guard(*this);
+    for (std::size_t index = 0; index < keys.size(); ++index)
+    {
+        const Node *node = find(hashOf(keys[index].data(), keys[index].size()), keys[index].data(), keys[index].size());
+        if (node != nullptr)
+        {
+            values[index].assign(node->value);
+        }
+        found = found && !values[index].empty();
+    }
+    return found;
+}
+
+/**
+ * @brief Streams key/value pairs of a "\*" key page by page in key order,
+ *        resuming the index walk after the last key of each page. Neither
+ *        the index nor a read guard is held while the visitor runs.
+ */
+inline bool InMemoryProvider::visitPages(const std::string &key, std::size_t pageSize, const PageVisitor &visitor)
+{
+    if (key.empty() || '*' != key.back())
+    {
+        return IPairWrittable::visitPages(key, pageSize, visitor);
+    }
+
+    const std::string prefix(key, 0, key.size() - 1);
+    const std::size_t limit(pageSize > 0 ? pageSize : 1);
+    std::vector<std::string> keys;
+    std::vector<KeyValuePair> page;
+    std::string after;
+    bool found(false);
+    for (;;)
+    {
+        {
+            std::lock_guard<std::mutex> guard(indexMutex_);
+            index_.collect(prefix, after, limit, keys);
+        }
+        if (keys.empty())
+        {
+            break;
+        }
+        after = keys.back();
+
+        page.clear();
+        {
+            ReadGuard guard(*this);
+            for (std::string &pageKey : keys)
+            {
+                const Node *node = find(hashOf(pageKey.data(), pageKey.size()), pageKey.data(), pageKey.size());
+                if (node != nullptr && !node->value.empty())
+                {
+                    page.push_back(KeyValuePair(std::move(pageKey), node->value));
+                }
+            }
+        }
+        if (!page.empty())
+        {
+            found = true;
+            if (!visitor(page))
+            {
+                break;
+            }
+        }
+        if (keys.size() < limit)
+        {
+            break;
+        }
+    }
+    return found;
+}
+
+/**
+ * @brief Sets value for given key.
+ *
+ * @return true - if succeded, false - otherwise
+ */
+inline bool InMemoryProvider::setValue(const std::string &key, const std::string &value)
+{
+    return setValue(key.data(), key.size(), value.data(), value.size());
+}
+
+inline bool InMemoryProvider::setValue(const char *key, std::size_t keyLength, const char *value, std::size_t valueLength)
+{
+    const std::uint64_t hash(hashOf(key, keyLength));
+    std::unique_ptr<Node> node(new Node());
+    node->hash = hash;
+    node->key.assign(key, keyLength);
+    node->value.assign(value, valueLength);
+
+    for (;;)
+    {
+        {
+            // The table cannot be replaced while a stripe is locked
+            std::lock_guard<std::mutex> guard(writeMutexes_[(hash >> 32) % writeStripes]);
+            Table &table = *table_.load();
+            if ((size_.load() + 1) * 2 <= table.mask + 1)
+            {
+                std::size_t index(hash & table.mask);
+                for (;;)
+                {
+                    Node *current = table.slots[index].load();
+                    if (current == nullptr)
+                    {
+                        if (table.slots[index].compare_exchange_strong(current, node.get()))
+                        {
+                            node.release();
+                            size_.fetch_add(1);
+                            if (keyLength > 0)
+                            {
+                                std::lock_guard<std::mutex> indexGuard(indexMutex_);
+                                index_.insert(std::string(key, keyLength));
+                            }
+                            return true;
+                        }
+                        // Taken by a key of another stripe: check it
+                    }
+                    if (current != nullptr)
+                    {
+                        if (current->hash == hash && current->key.size() == keyLength &&
+                            std::memcmp(current->key.data(), key, keyLength) == 0)
+                        {
+                            table.slots[index].exchange(node.release());
+                            retire(current, &InMemoryProvider::destroyNode);
+                            return true;
+                        }
+                        index = (index + 1) & table.mask;
+                    }
+                }
+            }
+        }
+        grow();
+    }
+}
+
+/**
+ * @brief Returns the number of keys
+ */
+inline std::size_t InMemoryProvider::size() const
+{
+    return size_.load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief FNV-1a
+ */
+inline std::uint64_t InMemoryProvider::hashOf(const char *key, std::size_t length)
+{
+    std::uint64_t hash(14695981039346656037ull);
+    for (std::size_t index = 0; index < length; ++index)
+    {
+        hash ^= static_cast<unsigned char>(key[index]);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+inline unsigned InMemoryProvider::readerSlot()
+{
+    static std::atomic<unsigned> next(0);
+    static thread_local unsigned slot(next.fetch_add(1, std::memory_order_relaxed) % readerSlots);
+    return slot;
+}
+
+inline void InMemoryProvider::destroyNode(void *node)
+{
+    delete static_cast<Node *>(node);
+}
+
+inline void InMemoryProvider::destroyTable(void *table)
+{
+    delete static_cast<Table *>(table);
+}
+
+/**
+ * @brief Probes for a key, the caller holds a ReadGuard
+ */
+inline const InMemoryProvider::Node *InMemoryProvider::find(std::uint64_t hash, const char *key,
+                                                            std::size_t length) const
+{
+    const Table &table = *table_.load();
+    for (std::size_t index = hash & table.mask;; index = (index + 1) & table.mask)
+    {
+        const Node *node = table.slots[index].load();
+        if (node == nullptr)
+        {
+            return nullptr;
+        }
+        if (node->hash == hash && node->key.size() == length && std::memcmp(node->key.data(), key, length) == 0)
+        {
+            return node;
+        }
+    }
+}
+
+/**
+ * @brief Visits all nodes with a key prefix and a value in key order until
+ *        the visitor returns false, the caller holds a ReadGuard
+ */
+template <class NodeVisitor>
+void InMemoryProvider::scan(const std::string &prefix, NodeVisitor visit) const
+{
+    std::lock_guard<std::mutex> guard(indexMutex_);
+    index_.visitPrefix(prefix, [this, &visit](const std::string &key) {
+        const Node *node = find(hashOf(key.data(), key.size()), key.data(), key.size());
+        return node == nullptr || node->value.empty() || visit(*node);
+    });
+}
+
+/**
+ * @brief Doubles the table with all stripes locked, readers carry on with the old one
+ */
+inline void InMemoryProvider::grow()
+{
+    for (std::mutex &mutex : writeMutexes_)
+    {
+        mutex.lock();
+    }
+
+    Table *table = table_.load();
+    if ((size_.load() + 1) * 2 > table->mask + 1)
+    {
+        Table *grown = new Table((table->mask + 1) * 2);
+        for (std::size_t index = 0; index <= table->mask; ++index)
+        {
+            Node *node = table->slots[index].load(std::memory_order_relaxed);
+            if (node != nullptr)
+            {
+                std::size_t target(node->hash & grown->mask);
+                while (grown->slots[target].load(std::memory_order_relaxed) != nullptr)
+                {
+                    target = (target + 1) & grown->mask;
+                }
+                grown->slots[target].store(node, std::memory_order_relaxed);
+            }
+        }
+        table_.store(grown);
+        retire(table, &InMemoryProvider::destroyTable); // nodes moved, not copied
+    }
+
+    for (std::mutex &mutex : writeMutexes_)
+    {
+        mutex.unlock();
+    }
+}
+
+inline void InMemoryProvider::retire(void *pointer, void (*destroy)(void *))
+{
+    std::lock_guard<std::mutex> guard(retiredMutex_);
+    Retired retired;
+    retired.pointer = pointer;
+    retired.destroy = destroy;
+    retired.epoch = epoch_.load();
+    retired_.push_back(retired);
+    if (++retiredSinceReclaim_ >= reclaimPeriod)
+    {
+        retiredSinceReclaim_ = 0;
+        reclaim();
+    }
+}
+
+/**
+ * @brief Advances the epoch if no reader is left in the previous one,
+ *        then frees what was retired two epochs ago or earlier.
+ *        The caller holds retiredMutex_.
+ */
+inline void InMemoryProvider::reclaim()
+{
+    std::uint64_t epoch(epoch_.load());
+    bool quiet(true);
+    for (const ReaderSlot &slot : readers_)
+    {
+        quiet = quiet && slot.active[(epoch + 2) % 3].load() == 0;
+    }
+    if (quiet)
+    {
+        epoch_.store(++epoch);
+    }
+
+    std::size_t kept(0);
+    for (std::size_t index = 0; index < retired_.size(); ++index)
+    {
+        if (retired_[index].epoch + 2 <= epoch)
+        {
+            retired_[index].destroy(retired_[index].pointer);
+        }
+        else
+        {
+            retired_[kept++] = retired_[index];
+        }
+    }
+    retired_.resize(kept);
+}
+}
@@ -0,0 +1,167 @@
+// MIT License
+//
+// Copyright(c) 2018 Alex Tversky
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace Util
+{
+template <class Signature, std::size_t Capacity = 48>
+class InplaceFunction;
+
+/**
+ *  \brief InplaceFunction - move-only callable wrapper with inline storage
+ *
+ *  \details Unlike std::function it never allocates: a callable which does
+ *           not fit into Capacity bytes is rejected at compile time. The
+ *           default capacity makes the whole object one 64-byte cache line.
+ */
+template <class R, class... Args, std::size_t Capacity>
+class InplaceFunction<R(Args...), Capacity>
+{
+  public:
+    InplaceFunction() noexcept : ops_(nullptr)
+    {
+    }
+
+    InplaceFunction(std::nullptr_t) noexcept : ops_(nullptr)
+    {
+    }
+
+    template <class F,
+              class = typename std::enable_if<
+                  !std::is_same<typename std::decay<F>::type, InplaceFunction>::value>::type>
+    InplaceFunction(F &&callable) : ops_(&Model<typename std::decay<F>::type>::ops)
+    {
+        typedef typename std::decay<F>::type Callable;
+        static_assert(sizeof(Callable) <= Capacity,
+                      "Callable does not fit into InplaceFunction, increase Capacity");
+        static_assert(alignof(Callable) <= alignof(Storage),
+                      "Callable is over-aligned for InplaceFunction");
+        static_assert(std::is_nothrow_move_constructible<Callable>::value,
+                      "Callable must be nothrow move constructible");
+        new (&storage_) Callable(std::forward<F>(callable));
+    }
+
+    InplaceFunction(InplaceFunction &&other) noexcept : ops_(other.ops_)
+    {
+        if (ops_)
+        {
+            ops_->move(&storage_, &other.storage_);
+            other.ops_ = nullptr;
+        }
+    }
+
+    InplaceFunction &operator=(InplaceFunction &&other) noexcept
+    {
+        if (this != &other)
+        {
+            reset();
+            if (other.ops_)
+            {
+                other.ops_->move(&storage_, &other.storage_);
+                ops_ = other.ops_;
+                other.ops_ = nullptr;
+            }
+        }
+        return *this;
+    }
+
+    InplaceFunction &operator=(std::nullptr_t) noexcept
+    {
+        reset();
+        return *this;
+    }
+
+    ~InplaceFunction()
+    {
+        reset();
+    }
+
+    R operator()(Args... args)
+    {
+        return ops_->invoke(&storage_, std::forward<Args>(args)...);
+    }
+
+    explicit operator bool() const noexcept
+    {
+        return ops_ != nullptr;
+    }
+
+  private:
+    InplaceFunction(const InplaceFunction &other) = delete;
+    InplaceFunction &operator=(const InplaceFunction &other) = delete;
+
+    typedef typename std::aligned_storage<Capacity, alignof(std::max_align_t)>::type Storage;
+
+    struct Ops
+    {
+        R (*invoke)(void *callable, Args &&... args);
+        void (*move)(void *destination, void *source);
+        void (*destroy)(void *callable);
+    };
+
+    template <class F>
+    struct Model
+    {
+        static R invoke(void *callable, Args &&... args)
+        {
+            return static_cast<R>((*static_cast<F *>(callable))(std::forward<Args>(args)...));
+        }
+
+        static void move(void *destination, void *source)
+        {
+            new (destination) F(std::move(*static_cast<F *>(source)));
+            static_cast<F *>(source)->~F();
+        }
+
+        static void destroy(void *callable)
+        {
+            static_cast<F *>(callable)->~F();
+        }
+
+        static const Ops ops;
+    };
+
+    void reset() noexcept
+    {
+        if (ops_)
+        {
+            ops_->destroy(&storage_);
+            ops_ = nullptr;
+        }
+    }
+
+  private:
+    Storage storage_;
+    const Ops *ops_;
+};
+
+template <class R, class... Args, std::size_t Capacity>
+template <class F>
+const typename InplaceFunction<R(Args...), Capacity>::Ops
+    InplaceFunction<R(Args...), Capacity>::Model<F>::ops = {&Model<F>::invoke, &Model<F>::move,
+                                                            &Model<F>::destroy};
+}
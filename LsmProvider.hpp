@@ -0,0 +1,1260 @@
+// MIT License
+// 
+// Copyright(c) 2018 Alex Tversky
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#pragma once
+
+#include "Util/BloomFilter.hpp"
+#include "Util/ILogProvider.hpp"
+#include "Util/IPairWrittable.hpp"
+#include "Util/SnapshotProvider.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <dirent.h> // POSIX only
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace Util
+{
+/**
+ *  \brief LsmOptions - tuning of an LsmProvider
+ */
+struct LsmOptions
+{
+    LsmOptions() : memtableBytes(4 << 20), syncWrites(true), compactionTrigger(4), bloomBitsPerKey(10)
+    {
+    }
+
+    std::size_t memtableBytes;  // keys and values buffered before a flush into a segment
+    bool syncWrites;            // fdatasync the write-ahead log before a write returns
+    unsigned compactionTrigger; // newest segments of similar size which are merged, at least 2
+    unsigned bloomBitsPerKey;   // 10 gives about 1% false positives
+};
+
+/**
+ *   \brief  LsmProvider supports IPairWrittable as an embedded durable store,
+ *           a log-structured merge tree in a directory.
+ *
+ *   \details A write is appended to a write-ahead log (wal-N.log), then
+ *            applied to a sorted in-memory memtable. A full memtable is
+ *            frozen and a background thread writes it as an immutable sorted
+ *            segment (segment-N-N.snap, the SnapshotProvider format) with a
+ *            Bloom filter (.bloom), then drops its log. Once enough of the
+ *            newest segments are of similar size, another thread merges them
+ *            into one, dropping overwritten values, so every value is
+ *            rewritten about log(n) times. The merge streams from the mapped
+ *            segments into the new file, and writers never wait for it.
+ *            Lookups go memtable, frozen memtable, then segments newest
+ *            first, skipping segments whose Bloom filter rules the key out.
+ *            "\*" keys merge the sorted sources. Setting an empty value
+ *            deletes (a tombstone until compaction). Opening replays logs
+ *            left by a crash. Thread safe.
+ */
+class LsmProvider : public IPairWrittable
+{
+  public:
+    using IPairWrittable::getValue;
+    using IPairWrittable::setValue;
+
+    LsmProvider(Util::ILogProvider &logger, const std::string &directory, const LsmOptions &options = LsmOptions());
+    virtual ~LsmProvider();
+
+    bool getKeyValue(const std::string &key, std::vector<KeyValuePair> &values) override;
+    bool getValue(const std::string &key, std::vector<std::string> &values) override;
+    bool setValue(const std::string &key, const std::string &value) override;
+    bool setValues(const std::vector<KeyValuePair> &pairs) override;
+    bool getValue(const char *key, std::size_t keyLength, std::string &value) override;
+    bool setValue(const char *key, std::size_t keyLength, const char *value, std::size_t valueLength) override;
+    bool visitPages(const std::string &key, std::size_t pageSize, const PageVisitor &visitor) override;
+
+    bool isOpen() const;
+    bool sync();
+    bool flush();
+    bool compact();
+    std::size_t segmentCount() const;
+
+  private:
+    LsmProvider() = delete;
+    LsmProvider(const LsmProvider &other) = delete;
+    LsmProvider(const LsmProvider &&other) = delete;
+    LsmProvider &operator=(const LsmProvider &other) = delete;
+    LsmProvider &operator=(const LsmProvider &&other) = delete;
+
+    typedef std::map<std::string, std::string> Pairs;
+
+    struct Memtable
+    {
+        Memtable() : bytes(0), sequence(0)
+        {
+        }
+
+        Pairs pairs;
+        std::size_t bytes;
+        std::uint64_t sequence; // of its log and of the segment it becomes
+    };
+
+    struct Segment
+    {
+        Segment(Util::ILogProvider &logger, const std::string &file)
+            : reader(logger, file), path(file), bytes(0), first(0), last(0)
+        {
+        }
+
+        SnapshotProvider reader;
+        BloomFilter bloom;
+        std::string path;
+        std::uint64_t bytes; // of the file, to pick similarly sized segments to merge
+        std::uint64_t first; // sequences of the memtables it holds
+        std::uint64_t last;
+    };
+
+    typedef std::vector<std::shared_ptr<const Segment>> Segments; // oldest first
+
+    /**
+     *  \brief A position in one sorted source of a merge
+     */
+    struct Cursor
+    {
+        const Segment *segment; // or a map
+        std::size_t index;
+        Pairs::const_iterator position;
+        Pairs::const_iterator end;
+        bool valid;
+        const char *key;
+        std::size_t keyLength;
+        const char *value;
+        std::size_t valueLength;
+    };
+
+    bool open();
+    bool openLog(std::uint64_t sequence);
+    bool commit(const std::string &records, const std::vector<KeyValuePair> &pairs);
+    void rollBack(off_t start);
+    void apply(Memtable &memtable, const std::string &key, const std::string &value);
+    void freeze(std::unique_lock<std::mutex> &lock);
+    void work();
+    void compactWork();
+    std::size_t pickCompaction(const Segments &segments, bool all) const;
+    bool replay(const std::string &path, Memtable &memtable);
+    std::shared_ptr<const Segment> writeSegment(const Pairs &pairs, std::uint64_t first, std::uint64_t last);
+    std::shared_ptr<const Segment> completeSegment(const std::string &path, const BloomFilter &bloom,
+                                                   std::uint64_t first, std::uint64_t last);
+    std::shared_ptr<const Segment> loadSegment(const std::string &path, std::uint64_t first, std::uint64_t last);
+    std::shared_ptr<const Segment> compactSegments(const Segments &inputs, bool dropTombstones);
+    template <class PairVisitor>
+    void scan(const std::string &prefix, PairVisitor visit);
+    template <class PairVisitor>
+    static void merge(std::vector<Cursor> &cursors, const std::string &prefix, PairVisitor visit,
+                      bool keepTombstones = false);
+    static void advance(Cursor &cursor, const std::string &prefix);
+    static void settle(Cursor &cursor, const std::string &prefix);
+    static void encode(std::string &records, const char *key, std::size_t keyLength,
+                       const char *value, std::size_t valueLength);
+    static std::uint32_t checksumOf(const char *key, std::size_t keyLength, const char *value, std::size_t valueLength);
+    std::string pathOf(const char *kind, std::uint64_t first, std::uint64_t last) const;
+    void syncDirectory() const;
+
+  private:
+    Util::ILogProvider &loggerRef_;
+    const std::string directory_;
+    const LsmOptions options_;
+    bool open_;
+    int logFd_;
+    std::uint64_t nextSequence_;
+    std::shared_ptr<Memtable> memtable_;
+    std::shared_ptr<const Memtable> frozen_;  // being written as a segment
+    std::shared_ptr<const Segments> segments_; // replaced, never changed in place
+    bool compactRequested_;
+    std::atomic<bool> running_; // also read by a merge in progress, to stop it
+    std::mutex writeMutex_;     // orders log appends, outer to mutex_
+    mutable std::mutex mutex_;  // memtables and segments
+    std::condition_variable cv_;
+    std::condition_variable compactCv_;
+    std::condition_variable doneCv_;
+    std::thread thread_;        // flushes
+    std::thread compactThread_; // merges segments
+};
+
+/**
+ * @brief Constructor, opens or creates a store (see isOpen())
+ *
+ * @param logger - a logger
+ * @param directory - a directory owned by this store, created if missing
+ * @param options - tuning
+ */
+inline LsmProvider::LsmProvider(Util::ILogProvider &logger, const std::string &directory, const LsmOptions &options)
+    : loggerRef_(logger), directory_(directory), options_(options), open_(false), logFd_(-1), nextSequence_(1),
+      segments_(new Segments()), compactRequested_(false), running_(true)
+{
+    open_ = open();
+    if (open_)
+    {
+        thread_ = std::thread(&LsmProvider::work, this);
+        compactThread_ = std::thread(&LsmProvider::compactWork, this);
+    }
+}
+
+/**
+ * @brief Destructor, completes a flush in progress and abandons a merge;
+ *        the memtable stays in its log
+ */
+inline LsmProvider::~LsmProvider()
+{
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        running_ = false;
+    }
+    cv_.notify_all();
+    compactCv_.notify_all();
+    if (thread_.joinable())
+    {
+        thread_.join();
+    }
+    if (compactThread_.joinable())
+    {
+        compactThread_.join();
+    }
+    if (logFd_ >= 0)
+    {
+        if (!options_.syncWrites)
+        {
+            fdatasync(logFd_);
+        }
+        close(logFd_);
+    }
+}
+
+/**
+ * @brief Retrieves value/s by key, as Key/Value pairs
+ *
+ * @param [in] key - a key (can have "\*" notation, e.g. "printer/terminal/\*")
+ * @param [out] values - a single or multiple values
+ * @return true - if key found
+ * @return false - if key not found
+ */
+inline bool LsmProvider::getKeyValue(const std::string &key, std::vector<KeyValuePair> &values)
+{
+    values.clear();
+    if (key.empty())
+    {
+        return false;
+    }
+    if ('*' == key.back())
+    {
+        scan(key.substr(0, key.size() - 1),
+             [&values](const char *pairKey, std::size_t keyLength, const char *value, std::size_t valueLength) {
+                 values.push_back(KeyValuePair(std::string(pairKey, keyLength), std::string(value, valueLength)));
+                 return true;
+             });
+    }
+    else
+    {
+        std::string value;
+        if (getValue(key.data(), key.size(), value))
+        {
+            values.push_back(KeyValuePair(key, std::move(value)));
+        }
+    }
+    return !values.empty();
+}
+
+/**
+ * @brief Retrieves value/s by key.
+ *
+ * @param [in] key - a key (can have "\*" notation, e.g. "printer/terminal/\*")
+ * @param [out] values - a single or multiple values
+ * @return true - if key found
+ * @return false - if key not found
+ */
+inline bool LsmProvider::getValue(const std::string &key, std::vector<std::string> &values)
+{
+    values.clear();
+    if (key.empty())
+    {
+        return false;
+    }
+    if ('*' == key.back())
+    {
+        scan(key.substr(0, key.size() - 1),
+             [&values](const char *, std::size_t, const char *value, std::size_t valueLength) {
+                 values.push_back(std::string(value, valueLength));
+                 return true;
+             });
+    }
+    else
+    {
+        values.resize(1);
+        if (!getValue(key.data(), key.size(), values[0]))
+        {
+            values.clear();
+        }
+    }
+    return !values.empty();
+}
+
+/**
+ * @brief Retrieves a value by an exact key into the caller's string
+ */
+inline bool LsmProvider::getValue(const char *key, std::size_t keyLength, std::string &value)
+{
+    value.clear();
+    if (!open_)
+    {
+        return false;
+    }
+
+    const std::string exact(key, keyLength);
+    std::shared_ptr<const Memtable> frozen;
+    std::shared_ptr<const Segments> segments;
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        Pairs::const_iterator found(memtable_->pairs.find(exact));
+        if (found != memtable_->pairs.end())
+        {
+            value.assign(found->second);
+            return !value.empty();
+        }
+        frozen = frozen_;
+        segments = segments_;
+    }
+
+    if (frozen)
+    {
+        Pairs::const_iterator found(frozen->pairs.find(exact));
+        if (found != frozen->pairs.end())
+        {
+            value.assign(found->second);
+            return !value.empty();
+        }
+    }
+    for (Segments::const_reverse_iterator segment = segments->rbegin(); segment != segments->rend(); ++segment)
+    {
+        if ((*segment)->bloom.mayContain(key, keyLength) && (*segment)->reader.find(key, keyLength, value))
+        {
+            return !value.empty();
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Sets value for given key, an empty value deletes it
+ *
+ * @return true - if logged (and synced with syncWrites), false - otherwise
+ */
+inline bool LsmProvider::setValue(const std::string &key, const std::string &value)
+{
+    return setValue(key.data(), key.size(), value.data(), value.size());
+}
+
+inline bool LsmProvider::setValue(const char *key, std::size_t keyLength, const char *value, std::size_t valueLength)
+{
+    std::string records;
+    encode(records, key, keyLength, value, valueLength);
+    std::vector<KeyValuePair> pairs;
+    pairs.push_back(KeyValuePair(std::string(key, keyLength), std::string(value, valueLength)));
+    return commit(records, pairs);
+}
+
+/**
+ * @brief Sets many values with one log append (and one sync)
+ */
+inline bool LsmProvider::setValues(const std::vector<KeyValuePair> &pairs)
+{
+    std::string records;
+    for (const KeyValuePair &pair : pairs)
+    {
+        encode(records, pair.key.data(), pair.key.size(), pair.value.data(), pair.value.size());
+    }
+    return commit(records, pairs);
+}
+
+/**
+ * @brief Streams key/value pairs of a key page by page, in key order
+ */
+inline bool LsmProvider::visitPages(const std::string &key, std::size_t pageSize, const PageVisitor &visitor)
+{
+    if (key.empty() || '*' != key.back())
+    {
+        return IPairWrittable::visitPages(key, pageSize, visitor);
+    }
+
+    const std::size_t limit(pageSize > 0 ? pageSize : 1);
+    std::vector<KeyValuePair> page;
+    bool found(false);
+    bool proceed(true);
+    scan(key.substr(0, key.size() - 1),
+         [&](const char *pairKey, std::size_t keyLength, const char *value, std::size_t valueLength) {
+             page.push_back(KeyValuePair(std::string(pairKey, keyLength), std::string(value, valueLength)));
+             if (page.size() >= limit)
+             {
+                 found = true;
+                 proceed = visitor(page);
+                 page.clear();
+             }
+             return proceed;
+         });
+    if (proceed && !page.empty())
+    {
+        found = true;
+        visitor(page);
+    }
+    return found;
+}
+
+inline bool LsmProvider::isOpen() const
+{
+    return open_;
+}
+
+/**
+ * @brief Makes all writes so far durable, for syncWrites off
+ *
+ * @return true - if succeded, false - otherwise
+ */
+inline bool LsmProvider::sync()
+{
+    std::lock_guard<std::mutex> guard(writeMutex_);
+    return logFd_ >= 0 && fdatasync(logFd_) == 0;
+}
+
+/**
+ * @brief Writes the memtable as a segment and waits for it
+ *
+ * @return true - if the memtable is in a segment, false - otherwise
+ */
+inline bool LsmProvider::flush()
+{
+    if (!open_)
+    {
+        return false;
+    }
+    std::lock_guard<std::mutex> writeGuard(writeMutex_);
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!memtable_->pairs.empty())
+    {
+        freeze(lock);
+    }
+    doneCv_.wait(lock, [this]() { return !frozen_ || !running_; });
+    return !frozen_;
+}
+
+/**
+ * @brief Merges all segments into one and waits for it
+ *
+ * @return true - if at most one segment is left, false - otherwise
+ */
+inline bool LsmProvider::compact()
+{
+    if (!open_)
+    {
+        return false;
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    compactRequested_ = true;
+    compactCv_.notify_all();
+    doneCv_.wait(lock, [this]() { return !compactRequested_ || !running_; });
+    return segments_->size() <= 1;
+}
+
+/**
+ * @brief Returns number of segment files
+ */
+inline std::size_t LsmProvider::segmentCount() const
+{
+    std::lock_guard<std::mutex> guard(mutex_);
+    return segments_->size();
+}
+
+/**
+ * @brief Recovers the store: drops leftovers, loads segments, replays logs
+ */
+inline bool LsmProvider::open()
+{
+    if (mkdir(directory_.c_str(), 0755) != 0 && errno != EEXIST)
+    {
+        loggerRef_.error("Failed to create " + directory_ + ": " + std::strerror(errno));
+        return false;
+    }
+    DIR *listing = opendir(directory_.c_str());
+    if (listing == nullptr)
+    {
+        loggerRef_.error("Failed to open " + directory_ + ": " + std::strerror(errno));
+        return false;
+    }
+
+    struct Found
+    {
+        std::string path;
+        std::uint64_t first;
+        std::uint64_t last;
+    };
+    std::vector<Found> segmentFiles;
+    std::vector<Found> logFiles;
+    for (dirent *entry = readdir(listing); entry != nullptr; entry = readdir(listing))
+    {
+        const std::string name(entry->d_name);
+        const std::string path(directory_ + "/" + name);
+        Found found;
+        found.path = path;
+        char *end(nullptr);
+        if (name.size() > 4 && name.compare(name.size() - 4, 4, ".tmp") == 0)
+        {
+            unlink(path.c_str()); // an interrupted segment write
+        }
+        else if (name.compare(0, 8, "segment-") == 0 && name.size() > 5 &&
+                 name.compare(name.size() - 5, 5, ".snap") == 0)
+        {
+            found.first = std::strtoull(name.c_str() + 8, &end, 10);
+            found.last = (*end == '-') ? std::strtoull(end + 1, &end, 10) : 0;
+            if (found.last >= found.first && found.first > 0)
+            {
+                segmentFiles.push_back(found);
+            }
+        }
+        else if (name.compare(0, 4, "wal-") == 0 && name.size() > 4 && name.compare(name.size() - 4, 4, ".log") == 0)
+        {
+            found.first = found.last = std::strtoull(name.c_str() + 4, &end, 10);
+            if (found.first > 0)
+            {
+                logFiles.push_back(found);
+            }
+        }
+    }
+    closedir(listing);
+
+    // A compaction may have stopped before removing its inputs
+    std::sort(segmentFiles.begin(), segmentFiles.end(),
+              [](const Found &left, const Found &right) { return left.last < right.last; });
+    Segments segments;
+    std::uint64_t lastSequence(0);
+    for (const Found &candidate : segmentFiles)
+    {
+        bool covered(false);
+        for (const Found &other : segmentFiles)
+        {
+            covered = covered || (&other != &candidate && other.first <= candidate.first &&
+                                  candidate.last <= other.last &&
+                                  (other.first != candidate.first || other.last != candidate.last));
+        }
+        if (covered)
+        {
+            unlink(candidate.path.c_str());
+            unlink((candidate.path + ".bloom").c_str());
+            continue;
+        }
+        std::shared_ptr<const Segment> segment(loadSegment(candidate.path, candidate.first, candidate.last));
+        if (!segment)
+        {
+            return false;
+        }
+        segments.push_back(segment);
+        lastSequence = std::max(lastSequence, candidate.last);
+    }
+
+    // Replay logs not in a segment yet, then write them as one
+    std::sort(logFiles.begin(), logFiles.end(),
+              [](const Found &left, const Found &right) { return left.first < right.first; });
+    Memtable recovered;
+    std::vector<std::string> replayed;
+    std::uint64_t firstReplayed(0);
+    for (const Found &log : logFiles)
+    {
+        if (log.first > lastSequence)
+        {
+            if (!replay(log.path, recovered))
+            {
+                return false;
+            }
+            firstReplayed = firstReplayed > 0 ? firstReplayed : log.first;
+            recovered.sequence = log.first;
+        }
+        replayed.push_back(log.path);
+    }
+    if (!recovered.pairs.empty())
+    {
+        std::shared_ptr<const Segment> segment(writeSegment(recovered.pairs, firstReplayed, recovered.sequence));
+        if (!segment)
+        {
+            return false;
+        }
+        segments.push_back(segment);
+        loggerRef_.info("Recovered " + std::to_string(recovered.pairs.size()) + " keys from logs in " + directory_);
+    }
+    for (const std::string &path : replayed)
+    {
+        unlink(path.c_str());
+    }
+    for (const Found &log : logFiles)
+    {
+        lastSequence = std::max(lastSequence, log.first);
+    }
+
+    segments_.reset(new Segments(segments));
+    nextSequence_ = lastSequence + 1;
+    memtable_.reset(new Memtable());
+    memtable_->sequence = nextSequence_++;
+    return openLog(memtable_->sequence);
+}
+
+inline bool LsmProvider::openLog(std::uint64_t sequence)
+{
+    const std::string path(pathOf("wal", sequence, 0));
+    logFd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (logFd_ < 0)
+    {
+        loggerRef_.error("Failed to open log " + path + ": " + std::strerror(errno));
+        return false;
+    }
+    syncDirectory();
+    return true;
+}
+
+/**
+ * @brief Appends records to the log, then applies the pairs to the memtable
+ */
+inline bool LsmProvider::commit(const std::string &records, const std::vector<KeyValuePair> &pairs)
+{
+    if (!open_)
+    {
+        loggerRef_.error("Store " + directory_ + " is not open! Cannot set any values!");
+        return false;
+    }
+
+    std::lock_guard<std::mutex> writeGuard(writeMutex_);
+    if (logFd_ < 0)
+    {
+        loggerRef_.error("No log open in " + directory_ + "! Cannot set any values!");
+        return false;
+    }
+    const off_t start(lseek(logFd_, 0, SEEK_END));
+    std::size_t written(0);
+    while (written < records.size())
+    {
+        const ssize_t result(::write(logFd_, records.data() + written, records.size() - written));
+        if (result < 0 && errno != EINTR)
+        {
+            loggerRef_.error("Failed to append to log in " + directory_ + ": " + std::strerror(errno));
+            rollBack(start);
+            return false;
+        }
+        written += result > 0 ? static_cast<std::size_t>(result) : 0;
+    }
+    if (options_.syncWrites && fdatasync(logFd_) != 0)
+    {
+        loggerRef_.error("Failed to sync log in " + directory_ + ": " + std::strerror(errno));
+        rollBack(start);
+        return false;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (const KeyValuePair &pair : pairs)
+    {
+        apply(*memtable_, pair.key, pair.value);
+    }
+    if (memtable_->bytes >= options_.memtableBytes)
+    {
+        freeze(lock);
+    }
+    return true;
+}
+
+/**
+ * @brief Cuts a failed append off the log, so later records are not lost
+ *        behind a torn one on replay. Closes the log (failing all further
+ *        writes) if that is not possible.
+ */
+inline void LsmProvider::rollBack(off_t start)
+{
+    if (start >= 0 && ftruncate(logFd_, start) == 0 && (!options_.syncWrites || fdatasync(logFd_) == 0))
+    {
+        return;
+    }
+    loggerRef_.error("Failed to roll back log in " + directory_ + ", no more writes: " + std::strerror(errno));
+    close(logFd_);
+    logFd_ = -1;
+}
+
+inline void LsmProvider::apply(Memtable &memtable, const std::string &key, const std::string &value)
+{
+    std::pair<Pairs::iterator, bool> inserted(memtable.pairs.insert(Pairs::value_type(key, value)));
+    if (inserted.second)
+    {
+        memtable.bytes += key.size() + value.size();
+    }
+    else
+    {
+        memtable.bytes += value.size();
+        memtable.bytes -= std::min(memtable.bytes, inserted.first->second.size());
+        inserted.first->second.assign(value);
+    }
+}
+
+/**
+ * @brief Hands the memtable to the background thread and starts a new log.
+ *        Waits for the previous one to be written first. The caller holds
+ *        writeMutex_ and mutex_ (through the lock).
+ */
+inline void LsmProvider::freeze(std::unique_lock<std::mutex> &lock)
+{
+    doneCv_.wait(lock, [this]() { return !frozen_ || !running_; });
+    if (frozen_)
+    {
+        return; // stopping
+    }
+
+    frozen_ = memtable_;
+    memtable_.reset(new Memtable());
+    memtable_->sequence = nextSequence_++;
+    if (!options_.syncWrites)
+    {
+        fdatasync(logFd_);
+    }
+    close(logFd_);
+    openLog(memtable_->sequence); // on failure writes fail until reopened
+    cv_.notify_all();
+}
+
+inline void LsmProvider::work()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true)
+    {
+        cv_.wait(lock, [this]() { return !running_ || frozen_; });
+
+        if (frozen_)
+        {
+            std::shared_ptr<const Memtable> frozen(frozen_);
+            lock.unlock();
+            std::shared_ptr<const Segment> segment(writeSegment(frozen->pairs, frozen->sequence, frozen->sequence));
+            lock.lock();
+            if (!segment)
+            {
+                cv_.wait_for(lock, std::chrono::seconds(1)); // e.g. disk full: retry, writers wait meanwhile
+                continue;
+            }
+            std::shared_ptr<Segments> segments(new Segments(*segments_));
+            segments->push_back(segment);
+            segments_ = segments;
+            frozen_.reset();
+            unlink(pathOf("wal", frozen->sequence, 0).c_str());
+            doneCv_.notify_all();
+            compactCv_.notify_all();
+            continue;
+        }
+        if (!running_)
+        {
+            break;
+        }
+    }
+    doneCv_.notify_all();
+}
+
+/**
+ * @brief Merges segments on a thread of its own, so flushes (and writers
+ *        waiting for one) never queue behind a merge
+ */
+inline void LsmProvider::compactWork()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true)
+    {
+        compactCv_.wait(lock, [this]() {
+            return !running_ || compactRequested_ || pickCompaction(*segments_, false) < segments_->size();
+        });
+        if (!running_)
+        {
+            break;
+        }
+
+        // Only segments are merged: the memtable keeps the newest values
+        const bool requested(compactRequested_);
+        const std::shared_ptr<const Segments> current(segments_);
+        const std::size_t begin(pickCompaction(*current, requested));
+        if (begin + 1 >= current->size())
+        {
+            // Nothing to merge, and the output would be written over its only input
+            compactRequested_ = false;
+            doneCv_.notify_all();
+            continue;
+        }
+        const Segments inputs(current->begin() + static_cast<std::ptrdiff_t>(begin), current->end());
+        lock.unlock();
+        std::shared_ptr<const Segment> merged(compactSegments(inputs, begin == 0));
+        lock.lock();
+        if (merged)
+        {
+            // Only this thread removes segments: the older ones are where they were,
+            // and segments flushed meanwhile are newer, kept after the merged one
+            std::shared_ptr<Segments> segments(
+                new Segments(segments_->begin(), segments_->begin() + static_cast<std::ptrdiff_t>(begin)));
+            segments->push_back(merged);
+            segments->insert(segments->end(), segments_->begin() + static_cast<std::ptrdiff_t>(begin + inputs.size()),
+                             segments_->end());
+            segments_ = segments;
+            for (const std::shared_ptr<const Segment> &input : inputs)
+            {
+                if (input->path != merged->path)
+                {
+                    unlink(input->path.c_str()); // still mapped by readers holding it
+                    unlink((input->path + ".bloom").c_str());
+                }
+            }
+        }
+        if (requested)
+        {
+            compactRequested_ = false;
+            doneCv_.notify_all();
+        }
+        if (!merged && running_)
+        {
+            compactCv_.wait_for(lock, std::chrono::seconds(1));
+        }
+    }
+    doneCv_.notify_all();
+}
+
+/**
+ * @brief Picks the segments to merge: the newest ones, each older one joining
+ *        while it is no bigger than those picked so far together, so merges
+ *        combine similar amounts of data; or all of them on request
+ *
+ * @return the index of the oldest segment to merge, segments.size() if none
+ */
+inline std::size_t LsmProvider::pickCompaction(const Segments &segments, bool all) const
+{
+    if (segments.size() < 2)
+    {
+        return segments.size();
+    }
+    if (all)
+    {
+        return 0;
+    }
+
+    std::size_t begin(segments.size() - 1);
+    std::uint64_t bytes(segments[begin]->bytes);
+    while (begin > 0 && segments[begin - 1]->bytes <= bytes)
+    {
+        --begin;
+        bytes += segments[begin]->bytes;
+    }
+    return segments.size() - begin >= std::max(options_.compactionTrigger, 2u) ? begin : segments.size();
+}
+
+/**
+ * @brief Applies the records of a log to a memtable, up to a torn or corrupt record
+ */
+inline bool LsmProvider::replay(const std::string &path, Memtable &memtable)
+{
+    std::ifstream stream(path.c_str(), std::ios::binary);
+    if (!stream.is_open())
+    {
+        loggerRef_.error("Failed to read log " + path);
+        return false;
+    }
+
+    stream.seekg(0, std::ios::end);
+    std::uint64_t left(static_cast<std::uint64_t>(stream.tellg()));
+    stream.seekg(0, std::ios::beg);
+
+    std::string key;
+    std::string value;
+    std::size_t records(0);
+    while (true)
+    {
+        std::uint32_t header[3] = {};
+        stream.read(reinterpret_cast<char *>(header), sizeof(header));
+        if (!stream.good())
+        {
+            break;
+        }
+        left -= sizeof(header);
+        if (std::uint64_t(header[0]) + header[1] > left)
+        {
+            // Lengths of a torn tail are garbage, do not allocate them
+            loggerRef_.warn("Log " + path + " ends with a torn record after " + std::to_string(records) + " records");
+            break;
+        }
+        left -= std::uint64_t(header[0]) + header[1];
+        key.resize(header[0]);
+        value.resize(header[1]);
+        stream.read(&key[0], static_cast<std::streamsize>(key.size()));
+        stream.read(&value[0], static_cast<std::streamsize>(value.size()));
+        if (!stream.good() || checksumOf(key.data(), key.size(), value.data(), value.size()) != header[2])
+        {
+            loggerRef_.warn("Log " + path + " ends with a torn record after " + std::to_string(records) + " records");
+            break;
+        }
+        apply(memtable, key, value);
+        ++records;
+    }
+    return true;
+}
+
+/**
+ * @brief Writes sorted pairs (with tombstones) as a durable segment with its Bloom filter
+ */
+inline std::shared_ptr<const LsmProvider::Segment> LsmProvider::writeSegment(const Pairs &pairs, std::uint64_t first,
+                                                                             std::uint64_t last)
+{
+    std::uint64_t keysSize(0);
+    std::uint64_t valuesSize(0);
+    for (const Pairs::value_type &pair : pairs)
+    {
+        keysSize += pair.first.size();
+        valuesSize += pair.second.size();
+    }
+
+    const std::string path(pathOf("segment", first, last));
+    SnapshotWriter writer;
+    BloomFilter bloom(pairs.size(), options_.bloomBitsPerKey);
+    bool written(writer.open(path, pairs.size(), keysSize, valuesSize));
+    for (Pairs::const_iterator pair = pairs.begin(); written && pair != pairs.end(); ++pair)
+    {
+        written = writer.add(pair->first.data(), pair->first.size(), pair->second.data(), pair->second.size());
+        bloom.add(pair->first.data(), pair->first.size());
+    }
+    if (!written || !writer.commit()) // synced
+    {
+        loggerRef_.error("Failed to write segment " + path);
+        return std::shared_ptr<const Segment>();
+    }
+    return completeSegment(path, bloom, first, last);
+}
+
+/**
+ * @brief Saves the Bloom filter of a written segment and opens it
+ */
+inline std::shared_ptr<const LsmProvider::Segment> LsmProvider::completeSegment(const std::string &path,
+                                                                                const BloomFilter &bloom,
+                                                                                std::uint64_t first,
+                                                                                std::uint64_t last)
+{
+    if (!bloom.save(path + ".bloom"))
+    {
+        loggerRef_.warn("Failed to write Bloom filter of " + path + ", rebuilt on open");
+    }
+    return loadSegment(path, first, last);
+}
+
+inline std::shared_ptr<const LsmProvider::Segment> LsmProvider::loadSegment(const std::string &path,
+                                                                            std::uint64_t first, std::uint64_t last)
+{
+    std::shared_ptr<Segment> segment(new Segment(loggerRef_, path));
+    if (!segment->reader.isOpen())
+    {
+        return std::shared_ptr<const Segment>();
+    }
+    segment->first = first;
+    segment->last = last;
+    struct stat status;
+    segment->bytes = stat(path.c_str(), &status) == 0 ? static_cast<std::uint64_t>(status.st_size) : 0;
+    if (!segment->bloom.load(path + ".bloom"))
+    {
+        BloomFilter bloom(segment->reader.size(), options_.bloomBitsPerKey);
+        const char *key(nullptr);
+        std::size_t keyLength(0);
+        const char *value(nullptr);
+        std::size_t valueLength(0);
+        for (std::size_t index = 0; segment->reader.entryAt(index, key, keyLength, value, valueLength); ++index)
+        {
+            bloom.add(key, keyLength);
+        }
+        segment->bloom = bloom;
+    }
+    return segment;
+}
+
+/**
+ * @brief Merges adjacent segments (oldest first) into one, dropping overwritten
+ *        values, and tombstones too if no older segment is left for them to hide.
+ *        Streams from the mapped inputs: one pass sizes the output, one writes it.
+ */
+inline std::shared_ptr<const LsmProvider::Segment> LsmProvider::compactSegments(const Segments &inputs,
+                                                                                bool dropTombstones)
+{
+    std::vector<Cursor> cursors;
+    auto rewind = [&cursors, &inputs]() {
+        cursors.clear();
+        for (Segments::const_reverse_iterator segment = inputs.rbegin(); segment != inputs.rend(); ++segment)
+        {
+            Cursor cursor = Cursor();
+            cursor.segment = segment->get();
+            cursors.push_back(cursor);
+        }
+    };
+
+    std::uint64_t count(0);
+    std::uint64_t keysSize(0);
+    std::uint64_t valuesSize(0);
+    rewind();
+    merge(cursors, std::string(),
+          [&](const char *, std::size_t keyLength, const char *, std::size_t valueLength) {
+              ++count;
+              keysSize += keyLength;
+              valuesSize += valueLength;
+              return true;
+          },
+          !dropTombstones);
+
+    const std::string path(pathOf("segment", inputs.front()->first, inputs.back()->last));
+    SnapshotWriter writer;
+    BloomFilter bloom(static_cast<std::size_t>(count), options_.bloomBitsPerKey);
+    bool written(writer.open(path, count, keysSize, valuesSize));
+    rewind();
+    merge(cursors, std::string(),
+          [&](const char *key, std::size_t keyLength, const char *value, std::size_t valueLength) {
+              written = written && writer.add(key, keyLength, value, valueLength) && running_.load();
+              bloom.add(key, keyLength);
+              return written;
+          },
+          !dropTombstones);
+    if (!running_)
+    {
+        return std::shared_ptr<const Segment>(); // stopping, the inputs stay
+    }
+    if (!written || !writer.commit())
+    {
+        loggerRef_.error("Failed to write segment " + path);
+        return std::shared_ptr<const Segment>();
+    }
+    return completeSegment(path, bloom, inputs.front()->first, inputs.back()->last);
+}
+
+/**
+ * @brief Visits the newest non-empty values of keys with a prefix, in key order
+ */
+template <class PairVisitor>
+void LsmProvider::scan(const std::string &prefix, PairVisitor visit)
+{
+    if (!open_)
+    {
+        return;
+    }
+
+    Pairs active;
+    std::shared_ptr<const Memtable> frozen;
+    std::shared_ptr<const Segments> segments;
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        for (Pairs::const_iterator pair = memtable_->pairs.lower_bound(prefix);
+             pair != memtable_->pairs.end() && pair->first.compare(0, prefix.size(), prefix) == 0; ++pair)
+        {
+            active.insert(active.end(), *pair);
+        }
+        frozen = frozen_;
+        segments = segments_;
+    }
+
+    // Newest first: the first cursor wins a key present in several
+    std::vector<Cursor> cursors;
+    Cursor cursor = Cursor();
+    cursor.position = active.lower_bound(prefix);
+    cursor.end = active.end();
+    cursors.push_back(cursor);
+    if (frozen)
+    {
+        cursor.position = frozen->pairs.lower_bound(prefix);
+        cursor.end = frozen->pairs.end();
+        cursors.push_back(cursor);
+    }
+    for (Segments::const_reverse_iterator segment = segments->rbegin(); segment != segments->rend(); ++segment)
+    {
+        cursor = Cursor();
+        cursor.segment = segment->get();
+        cursor.index = (*segment)->reader.lowerBound(prefix.data(), prefix.size());
+        cursors.push_back(cursor);
+    }
+    merge(cursors, prefix, visit);
+}
+
+/**
+ * @brief Merges sorted sources by key, the first source holding a key wins,
+ *        skipping empty values (tombstones) unless kept
+ *
+ * @param cursors - positioned at the first key not less than the prefix
+ * @param prefix - the prefix of all keys visited
+ * @param visit - called with each key and value, returns false to stop
+ * @param keepTombstones - whether empty values are visited too
+ */
+template <class PairVisitor>
+void LsmProvider::merge(std::vector<Cursor> &cursors, const std::string &prefix, PairVisitor visit,
+                        bool keepTombstones)
+{
+    for (Cursor &cursor : cursors)
+    {
+        settle(cursor, prefix);
+    }
+
+    while (true)
+    {
+        Cursor *best(nullptr);
+        for (Cursor &cursor : cursors)
+        {
+            if (!cursor.valid)
+            {
+                continue;
+            }
+            const int order(best == nullptr ? -1
+                                            : std::memcmp(cursor.key, best->key,
+                                                          std::min(cursor.keyLength, best->keyLength)));
+            if (order < 0 || (order == 0 && cursor.keyLength < best->keyLength))
+            {
+                best = &cursor; // ties keep the newer source
+            }
+        }
+        if (best == nullptr)
+        {
+            return;
+        }
+
+        if ((keepTombstones || best->valueLength > 0) &&
+            !visit(best->key, best->keyLength, best->value, best->valueLength))
+        {
+            return;
+        }
+        for (Cursor &cursor : cursors)
+        {
+            if (&cursor != best && cursor.valid && cursor.keyLength == best->keyLength &&
+                std::memcmp(cursor.key, best->key, best->keyLength) == 0)
+            {
+                advance(cursor, prefix); // shadowed by a newer source
+            }
+        }
+        advance(*best, prefix);
+    }
+}
+
+/**
+ * @brief Steps a cursor to its next key
+ */
+inline void LsmProvider::advance(Cursor &cursor, const std::string &prefix)
+{
+    if (cursor.segment != nullptr)
+    {
+        ++cursor.index;
+    }
+    else if (cursor.position != cursor.end)
+    {
+        ++cursor.position;
+    }
+    settle(cursor, prefix);
+}
+
+/**
+ * @brief Loads the key and value under a cursor, invalid past the prefix
+ */
+inline void LsmProvider::settle(Cursor &cursor, const std::string &prefix)
+{
+    if (cursor.segment != nullptr)
+    {
+        cursor.valid = cursor.segment->reader.entryAt(cursor.index, cursor.key, cursor.keyLength, cursor.value,
+                                                      cursor.valueLength);
+    }
+    else if ((cursor.valid = cursor.position != cursor.end))
+    {
+        cursor.key = cursor.position->first.data();
+        cursor.keyLength = cursor.position->first.size();
+        cursor.value = cursor.position->second.data();
+        cursor.valueLength = cursor.position->second.size();
+    }
+    cursor.valid = cursor.valid && cursor.keyLength >= prefix.size() &&
+                   std::memcmp(cursor.key, prefix.data(), prefix.size()) == 0;
+}
+
+/**
+ * @brief Appends a log record: key length, value length, checksum, key, value
+ */
+inline void LsmProvider::encode(std::string &records, const char *key, std::size_t keyLength,
+                                const char *value, std::size_t valueLength)
+{
+    const std::uint32_t header[3] = {static_cast<std::uint32_t>(keyLength), static_cast<std::uint32_t>(valueLength),
+                                     checksumOf(key, keyLength, value, valueLength)};
+    records.append(reinterpret_cast<const char *>(header), sizeof(header));
+    records.append(key, keyLength);
+    records.append(value, valueLength);
+}
+
+/**
+ * @brief FNV-1a over lengths, key and value
+ */
+inline std::uint32_t LsmProvider::checksumOf(const char *key, std::size_t keyLength, const char *value,
+                                             std::size_t valueLength)
+{
+    std::uint32_t hash(2166136261u);
+    const std::uint32_t lengths[2] = {static_cast<std::uint32_t>(keyLength), static_cast<std::uint32_t>(valueLength)};
+    const char *parts[3] = {reinterpret_cast<const char *>(lengths), key, value};
+    const std::size_t sizes[3] = {sizeof(lengths), keyLength, valueLength};
+    for (unsigned part = 0; part < 3; ++part)
+    {
+        for (std::size_t index = 0; index < sizes[part]; ++index)
+        {
+            hash ^= static_cast<unsigned char>(parts[part][index]);
+            hash *= 16777619u;
+        }
+    }
+    return hash;
+}
+
+inline std::string LsmProvider::pathOf(const char *kind, std::uint64_t first, std::uint64_t last) const
+{
+    char name[64];
+    if (last == 0)
+    {
+        std::snprintf(name, sizeof(name), "/%s-%020llu.log", kind, static_cast<unsigned long long>(first));
+    }
+    else
+    {
+        std::snprintf(name, sizeof(name), "/%s-%020llu-%020llu.snap", kind, static_cast<unsigned long long>(first),
+                      static_cast<unsigned long long>(last));
+    }
+    return directory_ + name;
+}
+
+/**
+ * @brief Makes created, renamed and removed files durable
+ */
+inline void LsmProvider::syncDirectory() const
+{
+    const int fd(::open(directory_.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+    if (fd >= 0)
+    {
+        fsync(fd);
+        close(fd);
+    }
+}
+}
@@ -0,0 +1,221 @@
+// MIT License
+// 
+// Copyright(c) 2018 Alex Tversky
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+namespace Util
+{
+/**
+ *  \brief ClockTraits - how a thread sleeps until a time point of a clock
+ *         and which wall time it runs on
+ *
+ *  \details Clock-parameterized timers wait through this, so a clock which
+ *           does not follow real time (ManualClock) can wake them up when
+ *           it moves.
+ */
+template <class Clock>
+struct ClockTraits
+{
+    /**
+     * @brief Returns the wall clock time, which periodic callbacks align to
+     */
+    static std::chrono::nanoseconds wallTime()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch());
+    }
+
+    /**
+     * @brief Waits until the predicate holds or the deadline passes
+     *
+     * @return the predicate
+     */
+    template <class Predicate>
+    static bool waitUntil(std::condition_variable &cv, std::unique_lock<std::mutex> &lock,
+                          typename Clock::time_point deadline, Predicate predicate)
+    {
+        return cv.wait_until(lock, deadline, predicate);
+    }
+};
+
+/**
+ *  \brief ManualClock - a steady clock which moves only when told to
+ *
+ *  \details Meets the standard clock requirements, so it can stand in for
+ *           std::chrono::steady_clock in CallbackWithTimeout, CallbackScheduler
+ *           and friends. Time starts at the epoch and is shared process-wide;
+ *           advance() wakes every timer waiting on it.
+ */
+class ManualClock
+{
+  public:
+    typedef std::chrono::nanoseconds duration;
+    typedef duration::rep rep;
+    typedef duration::period period;
+    typedef std::chrono::time_point<ManualClock> time_point;
+    static const bool is_steady = true;
+
+    static time_point now() noexcept;
+    static void advance(duration delta);
+    static void advanceTo(time_point time);
+
+    template <class Predicate>
+    static bool waitUntil(std::condition_variable &cv, std::unique_lock<std::mutex> &lock,
+                          time_point deadline, Predicate predicate);
+
+  private:
+    struct Waiter
+    {
+        std::condition_variable *cv;
+        std::mutex *mutex;
+    };
+
+    struct State
+    {
+        State() : now(0)
+        {
+        }
+
+        std::atomic<rep> now;
+        std::mutex mutex;
+        std::vector<Waiter *> waiters;
+    };
+
+    static State &state();
+    static void attach(Waiter &waiter);
+    static void detach(Waiter &waiter);
+};
+
+template <>
+struct ClockTraits<ManualClock>
+{
+    static std::chrono::nanoseconds wallTime()
+    {
+        return ManualClock::now().time_since_epoch(); // simulated time is its own wall clock
+    }
+
+    template <class Predicate>
+    static bool waitUntil(std::condition_variable &cv, std::unique_lock<std::mutex> &lock,
+                          ManualClock::time_point deadline, Predicate predicate)
+    {
+        return ManualClock::waitUntil(cv, lock, deadline, predicate);
+    }
+};
+
+inline ManualClock::time_point ManualClock::now() noexcept
+{
+    return time_point(duration(state().now.load(std::memory_order_acquire)));
+}
+
+/**
+ * @brief Moves the time forward and wakes up waiting timers
+ *
+ * @details Returns without waiting for the timers to run.
+ */
+inline void ManualClock::advance(duration delta)
+{
+    if (delta > duration::zero())
+    {
+        advanceTo(now() + delta);
+    }
+}
+
+/**
+ * @brief Moves the time forward to a time point, never backwards
+ */
+inline void ManualClock::advanceTo(time_point time)
+{
+    State &clock = state();
+    std::lock_guard<std::mutex> guard(clock.mutex);
+    if (time.time_since_epoch().count() <= clock.now.load(std::memory_order_relaxed))
+    {
+        return;
+    }
+    clock.now.store(time.time_since_epoch().count(), std::memory_order_release);
+    for (Waiter *waiter : clock.waiters)
+    {
+        // Passing through the waiter mutex orders the new time before its next check
+        std::lock_guard<std::mutex> waiterGuard(*waiter->mutex);
+        waiter->cv->notify_all();
+    }
+}
+
+/**
+ * @brief Waits until the predicate holds or the manual time reaches the deadline
+ *
+ * @details The caller's mutex is released while (de)registering the waiter,
+ *          so the predicate is re-checked after that.
+ * @return the predicate
+ */
+template <class Predicate>
+bool ManualClock::waitUntil(std::condition_variable &cv, std::unique_lock<std::mutex> &lock,
+                            time_point deadline, Predicate predicate)
+{
+    if (predicate() || now() >= deadline)
+    {
+        return predicate();
+    }
+
+    Waiter waiter;
+    waiter.cv = &cv;
+    waiter.mutex = lock.mutex();
+    lock.unlock();
+    attach(waiter);
+    lock.lock();
+
+    while (!predicate() && now() < deadline)
+    {
+        cv.wait(lock);
+    }
+
+    lock.unlock();
+    detach(waiter);
+    lock.lock();
+    return predicate();
+}
+
+inline ManualClock::State &ManualClock::state()
+{
+    static State clock;
+    return clock;
+}
+
+inline void ManualClock::attach(Waiter &waiter)
+{
+    State &clock = state();
+    std::lock_guard<std::mutex> guard(clock.mutex);
+    clock.waiters.push_back(&waiter);
+}
+
+inline void ManualClock::detach(Waiter &waiter)
+{
+    State &clock = state();
+    std::lock_guard<std::mutex> guard(clock.mutex);
+    clock.waiters.erase(std::find(clock.waiters.begin(), clock.waiters.end(), &waiter));
+}
+}
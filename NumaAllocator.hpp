@@ -0,0 +1,337 @@
+// MIT License
+//
+// Copyright(c) 2018 Alex Tversky
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+
+#include <numa.h>  // libnuma API (link with -lnuma)
+#include <sched.h> // sched_getcpu
+
+namespace Util
+{
+/**
+ *  \brief NumaArena - a memory arena which takes its chunks from a single NUMA node
+ *
+ *  \details Single-object allocations (e.g. std::list nodes) are carved out of
+ *           node-bound chunks and recycled through per-size free lists, so no
+ *           system call happens per element. Larger allocations go to the node
+ *           directly. Falls back to the global heap when NUMA is unavailable.
+ */
+class NumaArena
+{
+  public:
+    explicit NumaArena(int node, std::size_t chunkBytes = 256 * 1024);
+    virtual ~NumaArena();
+
+    void *allocate(std::size_t bytes, std::size_t count, std::size_t alignment = alignof(std::max_align_t));
+    void deallocate(void *ptr, std::size_t bytes, std::size_t count,
+                    std::size_t alignment = alignof(std::max_align_t));
+
+    int node() const;
+
+  private:
+    NumaArena(const NumaArena &other) = delete;
+    NumaArena(const NumaArena &&other) = delete;
+    NumaArena &operator=(const NumaArena &other) = delete;
+    NumaArena &operator=(const NumaArena &&other) = delete;
+
+    void *allocateOnNode(std::size_t bytes, std::size_t alignment);
+    void freeOnNode(void *ptr, std::size_t bytes);
+
+    static std::size_t alignmentOf(std::size_t alignment);
+
+  private:
+    struct FreeBlock
+    {
+        FreeBlock *next;
+    };
+
+    struct FreeList
+    {
+        std::size_t blockBytes;
+        std::size_t alignment;
+        FreeBlock *head;
+    };
+
+    const int node_;
+    const std::size_t chunkBytes_;
+    const bool numaAvailable_;
+    std::vector<void *> chunks_;
+    std::vector<FreeList> freeLists_;
+    char *chunkCursor_;
+    std::size_t chunkLeft_;
+    std::mutex mutex_;
+};
+
+inline NumaArena::NumaArena(int node, std::size_t chunkBytes)
+    : node_(node), chunkBytes_(chunkBytes), numaAvailable_(numa_available() >= 0),
+      chunkCursor_(nullptr), chunkLeft_(0)
+{
+}
+
+inline NumaArena::~NumaArena()
+{
+    for (void *chunk : chunks_)
+    {
+        freeOnNode(chunk, chunkBytes_);
+    }
+}
+
+inline int NumaArena::node() const
+{
+    return node_;
+}
+
+/**
+ * @brief Allocates storage for count objects of the given size
+ *
+ * @param bytes - size of a single object
+ * @param count - number of objects
+ * @param alignment - alignment of an object, a power of two up to a page
+ * @return pointer to node-local storage (throws std::bad_alloc on failure)
+ */
+inline void *NumaArena::allocate(std::size_t bytes, std::size_t count, std::size_t alignment)
+{
+    const std::size_t align(alignmentOf(alignment));
+    const std::size_t blockBytes((bytes + align - 1) / align * align);
+
+    if (count != 1 || blockBytes > chunkBytes_ / 16)
+    {
+        if (bytes > 0 && count > static_cast<std::size_t>(-1) / bytes)
+        {
+            throw std::bad_alloc();
+        }
+        return allocateOnNode(bytes * count, align);
+    }
+
+    std::lock_guard<std::mutex> guard(mutex_);
+    bool listed(false);
+    for (FreeList &list : freeLists_)
+    {
+        if (list.blockBytes == blockBytes && list.alignment == align)
+        {
+            if (list.head)
+            {
+                FreeBlock *block = list.head;
+                list.head = block->next;
+                return block;
+            }
+            listed = true;
+        }
+    }
+    if (!listed)
+    {
+        // Created here, so deallocate() never allocates
+        freeLists_.push_back(FreeList{blockBytes, align, nullptr});
+    }
+
+    // Chunks are page aligned, the cursor only needs padding for larger alignments
+    const std::size_t padding((align - reinterpret_cast<std::uintptr_t>(chunkCursor_) % align) % align);
+    if (chunkLeft_ < padding + blockBytes)
+    {
+        chunks_.reserve(chunks_.size() + 1); // push_back below cannot throw
+        chunkCursor_ = static_cast<char *>(allocateOnNode(chunkBytes_, 4096));
+        chunks_.push_back(chunkCursor_);
+        chunkLeft_ = chunkBytes_;
+    }
+    else
+    {
+        chunkCursor_ += padding;
+        chunkLeft_ -= padding;
+    }
+
+    void *block = chunkCursor_;
+    chunkCursor_ += blockBytes;
+    chunkLeft_ -= blockBytes;
+    return block;
+}
+
+/**
+ * @brief Returns storage obtained by allocate() with the same size and count,
+ *        never allocates (its free list exists since allocate())
+ */
+inline void NumaArena::deallocate(void *ptr, std::size_t bytes, std::size_t count, std::size_t alignment)
+{
+    const std::size_t align(alignmentOf(alignment));
+    const std::size_t blockBytes((bytes + align - 1) / align * align);
+
+    if (count != 1 || blockBytes > chunkBytes_ / 16)
+    {
+        freeOnNode(ptr, bytes * count);
+        return;
+    }
+
+    std::lock_guard<std::mutex> guard(mutex_);
+    FreeBlock *block = static_cast<FreeBlock *>(ptr);
+    for (FreeList &list : freeLists_)
+    {
+        if (list.blockBytes == blockBytes && list.alignment == align)
+        {
+            block->next = list.head;
+            list.head = block;
+            return;
+        }
+    }
+}
+
+inline void *NumaArena::allocateOnNode(std::size_t bytes, std::size_t alignment)
+{
+    void *ptr(nullptr);
+    if (numaAvailable_)
+    {
+        ptr = numa_alloc_onnode(bytes, node_); // page aligned
+    }
+    else if (posix_memalign(&ptr, std::max(alignment, sizeof(void *)), bytes) != 0)
+    {
+        ptr = nullptr;
+    }
+    if (ptr == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+inline void NumaArena::freeOnNode(void *ptr, std::size_t bytes)
+{
+    if (numaAvailable_)
+    {
+        numa_free(ptr, bytes);
+    }
+    else
+    {
+        std::free(ptr);
+    }
+}
+
+inline std::size_t NumaArena::alignmentOf(std::size_t alignment)
+{
+    return std::max(alignment, alignof(std::max_align_t));
+}
+
+/**
+ *  \brief NumaAllocator - STL allocator binding container storage to a NUMA node
+ *
+ *  \details Copies and rebinds share one NumaArena, so a container and its
+ *           internal node types all land on the same node, e.g.
+ *
+ *           typedef std::list<Msg, Util::NumaAllocator<Msg>> NodeList;
+ *           Util::FifoMultiThreaded<Msg, NodeList> fifo(NodeList(Util::NumaAllocator<Msg>(1)));
+ */
+template <class T>
+class NumaAllocator
+{
+  public:
+    typedef T value_type;
+
+    explicit NumaAllocator(int node) : arena_(std::make_shared<NumaArena>(node))
+    {
+    }
+
+    template <class U>
+    NumaAllocator(const NumaAllocator<U> &other) noexcept : arena_(other.arena())
+    {
+    }
+
+    static_assert(alignof(T) <= 4096, "NumaAllocator aligns to at most a page");
+
+    T *allocate(std::size_t count)
+    {
+        return static_cast<T *>(arena_->allocate(sizeof(T), count, alignof(T)));
+    }
+
+    void deallocate(T *ptr, std::size_t count) noexcept
+    {
+        arena_->deallocate(ptr, sizeof(T), count, alignof(T));
+    }
+
+    int node() const noexcept
+    {
+        return arena_->node();
+    }
+
+    const std::shared_ptr<NumaArena> &arena() const noexcept
+    {
+        return arena_;
+    }
+
+  private:
+    std::shared_ptr<NumaArena> arena_;
+};
+
+template <class T, class U>
+bool operator==(const NumaAllocator<T> &lhs, const NumaAllocator<U> &rhs) noexcept
+{
+    return lhs.arena() == rhs.arena();
+}
+
+template <class T, class U>
+bool operator!=(const NumaAllocator<T> &lhs, const NumaAllocator<U> &rhs) noexcept
+{
+    return !(lhs == rhs);
+}
+
+/**
+ * @brief Pins the calling thread (e.g. a queue consumer) to the CPUs of a NUMA node
+ *        and prefers that node for its own allocations.
+ *
+ * @param node - a NUMA node, typically NumaAllocator::node() of the consumed queue
+ * @return true - if pinned
+ * @return false - if NUMA is unavailable or the node is invalid
+ */
+inline bool pinThreadToNumaNode(int node)
+{
+    if (numa_available() < 0 || node < 0 || node > numa_max_node())
+    {
+        return false;
+    }
+    if (numa_run_on_node(node) != 0)
+    {
+        return false;
+    }
+    numa_set_preferred(node);
+    return true;
+}
+
+/**
+ * @brief Returns NUMA node of the CPU the calling thread currently runs on
+ *
+ * @return node number, or 0 if NUMA is unavailable
+ */
+inline int currentNumaNode()
+{
+    if (numa_available() < 0)
+    {
+        return 0;
+    }
+    const int cpu(sched_getcpu());
+    const int node(cpu >= 0 ? numa_node_of_cpu(cpu) : -1);
+    return node >= 0 ? node : 0;
+}
+}
@@ -0,0 +1,387 @@
+// MIT License
+// 
+// Copyright(c) 2018 Alex Tversky
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Util
+{
+/**
+ *  \brief RadixIndex - a set of keys as a radix tree, for prefix queries
+ *
+ *  \details Keys like "printer/terminal/1" share their common prefixes, so
+ *           enumerating or erasing all keys with a prefix costs the prefix
+ *           length plus the number of keys found, not the number of all
+ *           keys. Children are kept sorted: keys are visited in
+ *           lexicographic order, which lets collect() resume a paged
+ *           enumeration after the last key of the previous page.
+ *           Not thread safe: the owner's lock protects it.
+ */
+class RadixIndex
+{
+  public:
+    RadixIndex();
+    virtual ~RadixIndex();
+
+    bool insert(const std::string &key);
+    bool erase(const std::string &key);
+    bool contains(const std::string &key) const;
+    std::size_t erasePrefix(const std::string &prefix);
+    void clear();
+    std::size_t size() const;
+
+    template <class KeyVisitor>
+    void visitPrefix(const std::string &prefix, KeyVisitor visit) const;
+    std::size_t collect(const std::string &prefix, const std::string &after, std::size_t limit,
+                        std::vector<std::string> &keys) const;
+
+  private:
+    RadixIndex(const RadixIndex &other) = delete;
+    RadixIndex(const RadixIndex &&other) = delete;
+    RadixIndex &operator=(const RadixIndex &other) = delete;
+    RadixIndex &operator=(const RadixIndex &&other) = delete;
+
+    struct Node
+    {
+        Node() : terminal(false)
+        {
+        }
+
+        std::string label; // bytes on the edge from the parent
+        bool terminal;     // a key ends here
+        std::vector<std::unique_ptr<Node>> children; // sorted by the first label byte
+    };
+
+    static std::size_t childIndex(const Node &node, char first);
+    static std::size_t countOf(const Node &node);
+    static void mergeWithChild(Node &node);
+    template <class KeyVisitor>
+    static bool walk(const Node &node, std::string &path, const std::string &prefix, const std::string *after,
+                     KeyVisitor &visit);
+
+  private:
+    Node root_;
+    std::size_t size_;
+};
+
+inline RadixIndex::RadixIndex() : size_(0)
+{
+}
+
+inline RadixIndex::~RadixIndex()
+{
+}
+
+/**
+ * @brief Adds a key
+ *
+ * @return false - if the key was there already
+ */
+inline bool RadixIndex::insert(const std::string &key)
+{
+    Node *node = &root_;
+    std::size_t position(0);
+    while (position < key.size())
+    {
+        const std::size_t index(childIndex(*node, key[position]));
+        if (index == node->children.size() || node->children[index]->label[0] != key[position])
+        {
+            std::unique_ptr<Node> leaf(new Node());
+            leaf->label.assign(key, position, std::string::npos);
+            leaf->terminal = true;
+            node->children.insert(node->children.begin() + index, std::move(leaf));
+            ++size_;
+            return true;
+        }
+
+        std::unique_ptr<Node> &child = node->children[index];
+        const std::string &label = child->label;
+        std::size_t common(1);
+        while (common < label.size() && position + common < key.size() && label[common] == key[position + common])
+        {
+            ++common;
+        }
+        if (common < label.size())
+        {
+            // Split the edge where the key leaves it
+            std::unique_ptr<Node> middle(new Node());
+            middle->label.assign(label, 0, common);
+            child->label.erase(0, common);
+            middle->children.push_back(std::move(child));
+            child = std::move(middle);
+        }
+        node = child.get();
+        position += common;
+    }
+
+    if (node->terminal)
+    {
+        return false;
+    }
+    node->terminal = true;
+    ++size_;
+    return true;
+}
+
+/**
+ * @brief Removes a key, merging edges left with a single child
+ *
+ * @return false - if there was no such key
+ */
+inline bool RadixIndex::erase(const std::string &key)
+{
+    Node *parent = nullptr;
+    Node *node = &root_;
+    std::size_t position(0);
+    std::size_t index(0);
+    while (position < key.size())
+    {
+        index = childIndex(*node, key[position]);
+        if (index == node->children.size() ||
+            key.compare(position, node->children[index]->label.size(), node->children[index]->label) != 0)
+        {
+            return false;
+        }
+        position += node->children[index]->label.size();
+        parent = node;
+        node = node->children[index].get();
+    }
+    if (!node->terminal)
+    {
+        return false;
+    }
+
+    node->terminal = false;
+    --size_;
+    if (parent == nullptr)
+    {
+        return true; // the empty key
+    }
+    if (node->children.empty())
+    {
+        parent->children.erase(parent->children.begin() + index);
+        if (parent != &root_ && !parent->terminal && parent->children.size() == 1)
+        {
+            mergeWithChild(*parent);
+        }
+    }
+    else if (node->children.size() == 1)
+    {
+        mergeWithChild(*node);
+    }
+    return true;
+}
+
+inline bool RadixIndex::contains(const std::string &key) const
+{
+    const Node *node = &root_;
+    std::size_t position(0);
+    while (position < key.size())
+    {
+        const std::size_t index(childIndex(*node, key[position]));
+        if (index == node->children.size() ||
+            key.compare(position, node->children[index]->label.size(), node->children[index]->label) != 0)
+        {
+            return false;
+        }
+        position += node->children[index]->label.size();
+        node = node->children[index].get();
+    }
+    return node->terminal;
+}
+
+/**
+ * @brief Removes all keys starting with a prefix (including the prefix itself)
+ *
+ * @return number of keys removed
+ */
+inline std::size_t RadixIndex::erasePrefix(const std::string &prefix)
+{
+    if (prefix.empty())
+    {
+        const std::size_t removed(size_);
+        clear();
+        return removed;
+    }
+
+    Node *parent = &root_;
+    std::size_t position(0);
+    for (;;)
+    {
+        const std::size_t index(childIndex(*parent, prefix[position]));
+        if (index == parent->children.size())
+        {
+            return 0;
+        }
+        Node &child = *parent->children[index];
+        const std::string &label = child.label;
+        const std::size_t compared(std::min(label.size(), prefix.size() - position));
+        if (prefix.compare(position, compared, label, 0, compared) != 0)
+        {
+            return 0;
+        }
+        if (position + compared == prefix.size())
+        {
+            // The whole subtree of this child starts with the prefix
+            const std::size_t removed(countOf(child));
+            parent->children.erase(parent->children.begin() + index);
+            size_ -= removed;
+            if (parent != &root_ && !parent->terminal && parent->children.size() == 1)
+            {
+                mergeWithChild(*parent);
+            }
+            return removed;
+        }
+        position += compared;
+        parent = &child;
+    }
+}
+
+inline void RadixIndex::clear()
+{
+    root_.children.clear();
+    root_.terminal = false;
+    size_ = 0;
+}
+
+inline std::size_t RadixIndex::size() const
+{
+    return size_;
+}
+
+/**
+ * @brief Visits all keys starting with a prefix in lexicographic order
+ *
+ * @param prefix - a prefix, empty for all keys
+ * @param visit - called with each key, returns false to stop
+ */
+template <class KeyVisitor>
+void RadixIndex::visitPrefix(const std::string &prefix, KeyVisitor visit) const
+{
+    std::string path;
+    walk(root_, path, prefix, nullptr, visit);
+}
+
+/**
+ * @brief Collects a page of keys starting with a prefix, in lexicographic order
+ *
+ * @param [in] prefix - a prefix, empty for all keys
+ * @param [in] after - only keys greater than this, empty for the first page
+ * @param [in] limit - the most keys to collect
+ * @param [out] keys - the keys found, the last one resumes the next page
+ * @return number of keys collected, less than limit on the last page
+ */
+inline std::size_t RadixIndex::collect(const std::string &prefix, const std::string &after, std::size_t limit,
+                                       std::vector<std::string> &keys) const
+{
+    keys.clear();
+    if (limit == 0)
+    {
+        return 0;
+    }
+    auto visit = [&keys, limit](const std::string &key) {
+        keys.push_back(key);
+        return keys.size() < limit;
+    };
+    std::string path;
+    walk(root_, path, prefix, after.empty() ? nullptr : &after, visit);
+    return keys.size();
+}
+
+/**
+ * @brief Returns the index of the child whose label starts with a byte, or where to insert it
+ */
+inline std::size_t RadixIndex::childIndex(const Node &node, char first)
+{
+    return std::lower_bound(node.children.begin(), node.children.end(), first,
+                            [](const std::unique_ptr<Node> &child, char value) {
+                                return static_cast<unsigned char>(child->label[0]) <
+                                       static_cast<unsigned char>(value);
+                            }) -
+           node.children.begin();
+}
+
+inline std::size_t RadixIndex::countOf(const Node &node)
+{
+    std::size_t count(node.terminal ? 1 : 0);
+    for (const std::unique_ptr<Node> &child : node.children)
+    {
+        count += countOf(*child);
+    }
+    return count;
+}
+
+/**
+ * @brief Joins a non-terminal node with its only child
+ */
+inline void RadixIndex::mergeWithChild(Node &node)
+{
+    std::unique_ptr<Node> child(std::move(node.children.front()));
+    node.label += child->label;
+    node.terminal = child->terminal;
+    node.children.swap(child->children);
+}
+
+/**
+ * @brief Depth-first in order walk, skipping subtrees off the prefix or not after 'after'
+ *
+ * @return false - if the visitor stopped the walk
+ */
+template <class KeyVisitor>
+bool RadixIndex::walk(const Node &node, std::string &path, const std::string &prefix, const std::string *after,
+                      KeyVisitor &visit)
+{
+    if (node.terminal && path.size() >= prefix.size() && (after == nullptr || path.compare(*after) > 0))
+    {
+        if (!visit(path))
+        {
+            return false;
+        }
+    }
+
+    for (const std::unique_ptr<Node> &child : node.children)
+    {
+        const std::size_t length(path.size());
+        path += child->label;
+
+        // Every key below starts with path: it must agree with the prefix...
+        const std::size_t compared(std::min(path.size(), prefix.size()));
+        bool relevant(path.compare(0, compared, prefix, 0, compared) == 0);
+        // ...and either be after 'after', or lead to keys after it
+        relevant = relevant && (after == nullptr || path.compare(*after) > 0 ||
+                                after->compare(0, path.size(), path) == 0);
+
+        const std::string *childAfter((after != nullptr && path.compare(*after) > 0) ? nullptr : after);
+        const bool proceed(!relevant || walk(*child, path, prefix, childAfter, visit));
+        path.resize(length);
+        if (!proceed)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+}
@@ -24,6 +24,8 @@
 #include "Util/IPairWrittable.hpp"
 #include "Util/ILogProvider.hpp"
 #include <document.h> // RapidJOSN API
+#include <algorithm>  // std::sort
+#include <cstring>    // std::memchr
 #include <sstream>    // std::stringstream
 
 namespace Util
@@ -47,6 +49,9 @@ class RapidJsonProvider : public IPairWrittable
     }
 
   public:
+    using IPairWrittable::getValue;
+    using IPairWrittable::setValue;
+
     virtual ~RapidJsonProvider()
     {
     }
@@ -120,7 +125,7 @@ class RapidJsonProvider : public IPairWrittable
 
                 if (value.IsString() && 0 == parsedKey.compare(key))
                 {
-                    values.push_back(value.GetString());
+                    values.push_back(std::string(value.GetString(), value.GetStringLength()));
                     loggerRef_.debug("Found " + parsedKey + std::string("='") +
                                  values[0] + std::string("'"));
                 }
@@ -129,6 +134,124 @@ class RapidJsonProvider : public IPairWrittable
         return !values.empty();
     }
 
+    /**
+     * @brief Retrieves string value by key into the caller's string.
+     *        Key levels are looked up in place (no key copies, no DOM clone),
+     *        so a reused value string makes the lookup allocation free.
+     *
+     * @param [in] key - a key (can be multilevel/nested separated by "/" delimiter)
+     * @param [in] keyLength - the key length
+     * @param [out] value - a value, its capacity is reused
+     * @return true - if key found
+     * @return false - if key not found or parsing/initialization failed
+     */
+    bool getValue(const char *key, std::size_t keyLength, std::string &value) override
+    {
+        value.clear();
+        const rapidjson::Value *node = (initialized_ && keyLength > 0) ? &doc_ : nullptr;
+        std::size_t begin(0);
+        while (node != nullptr && begin <= keyLength)
+        {
+            const void *slash = std::memchr(key + begin, '/', keyLength - begin);
+            const std::size_t end(slash ? static_cast<const char *>(slash) - key : keyLength);
+            if (end == begin || !node->IsObject())
+            {
+                node = nullptr; // an empty level (e.g. "a//b") or a leaf in the middle
+                break;
+            }
+
+            const rapidjson::Value name(rapidjson::StringRef(key + begin, static_cast<rapidjson::SizeType>(end - begin)));
+            rapidjson::Value::ConstMemberIterator member = node->FindMember(name);
+            node = (member != node->MemberEnd()) ? &member->value : nullptr;
+            begin = end + 1;
+        }
+
+        if (node != nullptr && node->IsString())
+        {
+            value.assign(node->GetString(), node->GetStringLength());
+        }
+        return !value.empty();
+    }
+
+    /**
+     * @brief Retrieves string values of many keys in a single DOM walk.
+     *        Keys are visited in sorted order, so keys sharing a prefix
+     *        (e.g. "message_bus/...") walk down to it once; the DOM is
+     *        read in place rather than cloned.
+     *
+     * @param [in] keys - keys (can be multilevel/nested separated by "/" delimiter)
+     * @param [out] values - values[i] is the value of keys[i], empty if not found
+     * @return true - if all keys found
+     * @return false - if any key not found or parsing/initialization failed
+     */
+    bool getValues(const std::vector<std::string> &keys, std::vector<std::string> &values) override
+    {
+        resetValues(values, keys.size());
+        if (!initialized_)
+        {
+            return keys.empty();
+        }
+
+        std::vector<size_t> order(keys.size());
+        for (size_t index = 0; index < order.size(); ++index)
+        {
+            order[index] = index;
+        }
+        std::sort(order.begin(), order.end(),
+                  [&keys](size_t left, size_t right) { return keys[left] < keys[right]; });
+
+        bool found(true);
+        std::vector<std::string> keyLevels;
+        std::vector<std::string> path;               // levels walked for the previous key
+        std::vector<const rapidjson::Value *> nodes; // nodes[i] - the value at path[0..i]
+        for (size_t index : order)
+        {
+            const std::string &key = keys[index];
+            if (!splitKey(key, keyLevels))
+            {
+                found = false;
+                continue;
+            }
+
+            // Reuse the walk of the previous key down to the common prefix
+            size_t common(0);
+            while (common < keyLevels.size() && common < path.size() && keyLevels[common] == path[common])
+            {
+                ++common;
+            }
+            path.resize(common);
+            nodes.resize(common);
+
+            const rapidjson::Value *node = common > 0 ? nodes.back() : &doc_;
+            for (size_t level = common; node != nullptr && level < keyLevels.size(); ++level)
+            {
+                const rapidjson::Value *next = nullptr;
+                if (node->IsObject())
+                {
+                    rapidjson::Value::ConstMemberIterator member = node->FindMember(keyLevels[level].c_str());
+                    if (member != node->MemberEnd())
+                    {
+                        next = &member->value;
+                        path.push_back(keyLevels[level]);
+                        nodes.push_back(next);
+                    }
+                }
+                node = next;
+            }
+
+            if (node != nullptr && node->IsString())
+            {
+                values[index].assign(node->GetString(), node->GetStringLength());
+                loggerRef_.debug("Found " + key + std::string("='") + values[index] + std::string("'"));
+            }
+            else
+            {
+                found = false;
+            }
+        }
+        return found;
+    }
+
     /**
      * @brief Unsupported.
      * 
@@ -148,6 +271,36 @@ class RapidJsonProvider : public IPairWrittable
     RapidJsonProvider &operator=(const RapidJsonProvider &other) = delete;
     RapidJsonProvider &operator=(const RapidJsonProvider &&other) = delete;
 
+    /**
+     * @brief Tokenizes a multilevel key, the way getValue() matches it
+     *
+     * @param [in] key - a key
+     * @param [out] keyLevels - levels of the key
+     * @return false - if the key is empty or has an empty level (e.g. "a//b")
+     */
+    static bool splitKey(const std::string &key, std::vector<std::string> &keyLevels)
+    {
+        keyLevels.clear();
+        size_t begin(0);
+        while (begin <= key.size())
+        {
+            size_t end(key.find('/', begin));
+            end = (end == std::string::npos) ? key.size() : end;
+            if (end == begin)
+            {
+                break;
+            }
+            keyLevels.push_back(key.substr(begin, end - begin));
+            begin = end + 1;
+        }
+        if (keyLevels.empty() && !key.empty() && key.find_first_not_of('/') == std::string::npos)
+        {
+            keyLevels.push_back(key); // as getValue() does
+            return true;
+        }
+        return !keyLevels.empty() && begin == key.size() + 1;
+    }
+
   private:
     Util::ILogProvider &loggerRef_;
     rapidjson::Document doc_;
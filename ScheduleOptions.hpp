@@ -0,0 +1,208 @@
+// MIT License
+//
+// Copyright(c) 2018 Alex Tversky
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#pragma once
+
+#include "Util/ManualClock.hpp"
+#include <chrono>
+#include <cstdint>
+
+namespace Util
+{
+/**
+ *  \brief  How the next deadline of a periodic callback is derived
+ *
+ *  \details  SM_FIXED_DELAY - period counts from the end of the previous call,
+ *            SM_FIXED_RATE - period counts from the previous deadline
+ */
+enum ScheduleMode
+{
+    SM_FIXED_DELAY = 0,
+    SM_FIXED_RATE = 1
+};
+
+/**
+ *  \brief  What a fixed-rate callback does after running past its next deadline
+ *
+ *  \details  OP_CATCH_UP - runs the missed calls back to back,
+ *            OP_SKIP - drops the missed calls and keeps the original phase
+ */
+enum OverrunPolicy
+{
+    OP_CATCH_UP = 0,
+    OP_SKIP = 1
+};
+
+/**
+ *  \brief BackoffPolicy - how a failing callback is retried
+ *
+ *  \details The n-th consecutive failure delays the next call by
+ *           min(maximum, initial * multiplier^(n-1)), less a random part of
+ *           up to jitter of that, so failing callers do not retry in lockstep.
+ *           The first success returns to the regular schedule.
+ */
+struct BackoffPolicy
+{
+    BackoffPolicy()
+        : initial(std::chrono::milliseconds(100)), maximum(std::chrono::seconds(30)),
+          multiplier(2.0), jitter(0.5)
+    {
+    }
+
+    std::chrono::nanoseconds initial; // delay after the first failure, zero keeps the period
+    std::chrono::nanoseconds maximum; // the longest delay, zero for no limit
+    double multiplier;
+    double jitter;                    // 0..1
+};
+
+/**
+ *  \brief ScheduleOptions - options of a periodic callback
+ */
+struct ScheduleOptions
+{
+    ScheduleOptions()
+        : mode(SM_FIXED_DELAY), overrun(OP_SKIP), alignToPeriod(false),
+          slack(std::chrono::nanoseconds::zero())
+    {
+    }
+
+    ScheduleMode mode;
+    OverrunPolicy overrun;
+    bool alignToPeriod;             // first call on a wall clock multiple of the period
+    std::chrono::nanoseconds slack; // a call may be delayed this much to share a wakeup
+    BackoffPolicy backoff;          // applies to callbacks returning a status
+};
+
+/**
+ * @brief Computes the first deadline of a periodic callback
+ *
+ * @param now - current time
+ * @param period - a period
+ * @param options - schedule options
+ * @return now, or the next wall clock multiple of the period if aligned;
+ *         the wall clock comes from ClockTraits, a ManualClock aligns to itself
+ */
+template <class TimePoint>
+TimePoint firstDeadline(TimePoint now, typename TimePoint::duration period,
+                        const ScheduleOptions &options)
+{
+    typedef typename TimePoint::duration Duration;
+    if (!options.alignToPeriod || period <= Duration::zero())
+    {
+        return now;
+    }
+
+    const Duration sinceEpoch(
+        std::chrono::duration_cast<Duration>(ClockTraits<typename TimePoint::clock>::wallTime()));
+    const Duration phase(sinceEpoch % period);
+    return phase == Duration::zero() ? now : now + (period - phase);
+}
+
+/**
+ * @brief Computes the deadline following a completed call
+ *
+ * @param previous - the deadline of the completed call
+ * @param completed - the time the call returned
+ * @param period - a period
+ * @param options - schedule options
+ * @return the next deadline
+ */
+template <class TimePoint>
+TimePoint nextDeadline(TimePoint previous, TimePoint completed,
+                       typename TimePoint::duration period, const ScheduleOptions &options)
+{
+    typedef typename TimePoint::duration Duration;
+    if (options.mode == SM_FIXED_DELAY || period <= Duration::zero())
+    {
+        return completed + period;
+    }
+
+    const TimePoint next(previous + period);
+    if (next > completed || options.overrun == OP_CATCH_UP)
+    {
+        return next;
+    }
+
+    // Overrun: skip the missed deadlines, stay on the original phase
+    const typename TimePoint::rep missed((completed - previous) / period);
+    return previous + period * (missed + 1);
+}
+
+/**
+ * @brief Computes the delay before retrying a failed call
+ *
+ * @param policy - a backoff policy
+ * @param failures - number of consecutive failures, at least 1
+ * @param [in,out] random - state of the jitter generator, any non-zero seed
+ * @return the delay
+ */
+inline std::chrono::nanoseconds backoffDelay(const BackoffPolicy &policy, unsigned failures,
+                                             std::uint64_t &random)
+{
+    double delay(static_cast<double>(policy.initial.count()));
+    const double limit(policy.maximum.count() > 0 ? static_cast<double>(policy.maximum.count()) : 1e18);
+    for (unsigned failure = 1; failure < failures && delay < limit; ++failure)
+    {
+        delay *= policy.multiplier;
+    }
+    delay = delay < limit ? delay : limit;
+
+    // xorshift64*: cheap, and good enough to spread retries
+    random ^= random >> 12;
+    random ^= random << 25;
+    random ^= random >> 27;
+    const double uniform(static_cast<double>((random * 2685821657736338717ULL) >> 11) / 9007199254740992.0);
+    const double jitter(policy.jitter < 0.0 ? 0.0 : (policy.jitter > 1.0 ? 1.0 : policy.jitter));
+    return std::chrono::nanoseconds(static_cast<std::int64_t>(delay * (1.0 - jitter * uniform)));
+}
+
+/**
+ * @brief Computes the deadline following a call which reported its outcome
+ *
+ * @param previous - the deadline of the completed call
+ * @param completed - the time the call returned
+ * @param period - a period
+ * @param options - schedule options
+ * @param succeeded - the outcome of the call
+ * @param [in,out] failures - number of consecutive failures, reset by a success
+ * @param [in,out] random - state of the jitter generator
+ * @return the next deadline, backed off after a failure
+ */
+template <class TimePoint>
+TimePoint nextDeadline(TimePoint previous, TimePoint completed, typename TimePoint::duration period,
+                       const ScheduleOptions &options, bool succeeded, unsigned &failures,
+                       std::uint64_t &random)
+{
+    if (succeeded)
+    {
+        failures = 0;
+        return nextDeadline(previous, completed, period, options);
+    }
+
+    ++failures;
+    if (options.backoff.initial <= std::chrono::nanoseconds::zero())
+    {
+        return nextDeadline(previous, completed, period, options);
+    }
+    return completed + std::chrono::duration_cast<typename TimePoint::duration>(
+                           backoffDelay(options.backoff, failures, random));
+}
+}
@@ -0,0 +1,788 @@
+// MIT License
+// 
+// Copyright(c) 2018 Alex Tversky
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#pragma once
+
+#include "Util/ILogProvider.hpp"
+#include "Util/IPairWrittable.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <fcntl.h> // POSIX only
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace Util
+{
+/**
+ *  @brief Snapshot file header. The file is written and read with the host
+ *         byte order, i.e. snapshots are not portable across architectures.
+ *         Layout: header, index entries sorted by key, keys, values.
+ */
+struct SnapshotHeader
+{
+    char magic[8];               // "TLSNAP01"
+    std::uint64_t count;         // number of index entries
+    std::uint64_t indexOffset;   // of the first SnapshotEntry
+    std::uint64_t keysOffset;    // of the keys region
+    std::uint64_t valuesOffset;  // of the values region
+    std::uint64_t fileSize;
+    std::uint64_t reserved[2];
+};
+
+/**
+ *  @brief Snapshot index entry, offsets relative to their region
+ */
+struct SnapshotEntry
+{
+    std::uint64_t keyOffset;
+    std::uint64_t valueOffset;
+    std::uint32_t keyLength;
+    std::uint32_t valueLength;
+};
+
+static_assert(sizeof(SnapshotHeader) == 64, "SnapshotHeader layout");
+static_assert(sizeof(SnapshotEntry) == 24, "SnapshotEntry layout");
+
+/**
+ *   \brief  SnapshotProvider supports IPairWrittable, read-only,
+ *           serving values straight from a memory-mapped snapshot file.
+ *
+ *   \details Opening only maps the file: pages load on first access.
+ *            Exact keys are found by binary search over the sorted index,
+ *            "\*" keys as the range of keys with that prefix, so both cost
+ *            O(log n) plus the matches. Reads are thread safe.
+ *            Snapshots are written by SnapshotBuilder.
+ */
+class SnapshotProvider : public IPairWrittable
+{
+  public:
+    using IPairWrittable::getValue;
+    using IPairWrittable::setValue;
+
+    SnapshotProvider(Util::ILogProvider &logger, const std::string &path);
+    virtual ~SnapshotProvider();
+
+    bool getKeyValue(const std::string &key, std::vector<KeyValuePair> &values) override;
+    bool getValue(const std::string &key, std::vector<std::string> &values) override;
+    bool setValue(const std::string &key, const std::string &value) override;
+    bool getValue(const char *key, std::size_t keyLength, std::string &value) override;
+    bool visitPages(const std::string &key, std::size_t pageSize, const PageVisitor &visitor) override;
+
+    bool isOpen() const;
+    std::size_t size() const;
+
+    // Low-level access in key order, empty values (LsmProvider tombstones) included
+    bool find(const char *key, std::size_t keyLength, std::string &value) const;
+    std::size_t lowerBound(const char *key, std::size_t keyLength) const;
+    bool entryAt(std::size_t index, const char *&key, std::size_t &keyLength,
+                 const char *&value, std::size_t &valueLength) const;
+
+  private:
+    SnapshotProvider() = delete;
+    SnapshotProvider(const SnapshotProvider &other) = delete;
+    SnapshotProvider(const SnapshotProvider &&other) = delete;
+    SnapshotProvider &operator=(const SnapshotProvider &other) = delete;
+    SnapshotProvider &operator=(const SnapshotProvider &&other) = delete;
+
+    bool open(const std::string &path);
+    template <class PairVisitor>
+    void visitPrefix(const std::string &prefix, PairVisitor visit) const;
+
+  private:
+    Util::ILogProvider &loggerRef_;
+    const char *data_;
+    std::size_t size_;
+    const SnapshotHeader *header_;
+    const SnapshotEntry *entries_;
+};
+
+/**
+ * @brief Constructor, maps a snapshot (see isOpen())
+ *
+ * @param logger - a logger
+ * @param path - a snapshot written by SnapshotBuilder
+ */
+inline SnapshotProvider::SnapshotProvider(Util::ILogProvider &logger, const std::string &path)
+    : loggerRef_(logger), data_(nullptr), size_(0), header_(nullptr), entries_(nullptr)
+{
+    if (!open(path))
+    {
+        if (data_ != nullptr)
+        {
+            munmap(const_cast<char *>(data_), size_);
+        }
+        data_ = nullptr;
+        header_ = nullptr;
+        entries_ = nullptr;
+    }
+}
+
+inline SnapshotProvider::~SnapshotProvider()
+{
+    if (data_ != nullptr)
+    {
+        munmap(const_cast<char *>(data_), size_);
+    }
+}
+
+/**
+ * @brief Retrieves value/s by key, as Key/Value pairs
+ *
+ * @param [in] key - a key (can have "\*" notation, e.g. "printer/terminal/\*")
+ * @param [out] values - a single or multiple values
+ * @return true - if key found
+ * @return false - if key not found
+ */
+inline bool SnapshotProvider::getKeyValue(const std::string &key, std::vector<KeyValuePair> &values)
+{
+    values.clear();
+    if (key.empty())
+    {
+        return false;
+    }
+    if ('*' == key.back())
+    {
+        visitPrefix(key.substr(0, key.size() - 1),
+                    [&values](const char *pairKey, std::size_t keyLength, const char *value, std::size_t valueLength) {
+                        values.push_back(KeyValuePair(std::string(pairKey, keyLength), std::string(value, valueLength)));
+                        return true;
+                    });
+    }
+    else
+    {
+        std::string value;
+        if (getValue(key.data(), key.size(), value))
+        {
+            values.push_back(KeyValuePair(key, std::move(value)));
+        }
+    }
+    return !values.empty();
+}
+
+/**
+ * @brief Retrieves value/s by key.
+ *
+ * @param [in] key - a key (can have "\*" notation, e.g. "printer/terminal/\*")
+ * @param [out] values - a single or multiple values
+ * @return true - if key found
+ * @return false - if key not found
+ */
+inline bool SnapshotProvider::getValue(const std::string &key, std::vector<std::string> &values)
+{
+    values.clear();
+    if (key.empty())
+    {
+        return false;
+    }
+    if ('*' == key.back())
+    {
+        visitPrefix(key.substr(0, key.size() - 1),
+                    [&values](const char *, std::size_t, const char *value, std::size_t valueLength) {
+                        values.push_back(std::string(value, valueLength));
+                        return true;
+                    });
+    }
+    else
+    {
+        values.resize(1);
+        if (!getValue(key.data(), key.size(), values[0]))
+        {
+            values.clear();
+        }
+    }
+    return !values.empty();
+}
+
+/**
+ * @brief Snapshots are read-only
+ *
+ * @return false - always
+ */
+inline bool SnapshotProvider::setValue(const std::string &key, const std::string &value)
+{
+    (void)value;
+    loggerRef_.error("Snapshot is read-only! Cannot set " + key);
+    return false;
+}
+
+/**
+ * @brief Retrieves a value by an exact key into the caller's string
+ */
+inline bool SnapshotProvider::getValue(const char *key, std::size_t keyLength, std::string &value)
+{
+    find(key, keyLength, value);
+    return !value.empty();
+}
+
+/**
+ * @brief Streams key/value pairs of a key page by page, in key order
+ */
+inline bool SnapshotProvider::visitPages(const std::string &key, std::size_t pageSize, const PageVisitor &visitor)
+{
+    if (key.empty() || '*' != key.back())
+    {
+        return IPairWrittable::visitPages(key, pageSize, visitor);
+    }
+
+    const std::size_t limit(pageSize > 0 ? pageSize : 1);
+    std::vector<KeyValuePair> page;
+    bool found(false);
+    bool proceed(true);
+    visitPrefix(key.substr(0, key.size() - 1),
+                [&](const char *pairKey, std::size_t keyLength, const char *value, std::size_t valueLength) {
+                    page.push_back(KeyValuePair(std::string(pairKey, keyLength), std::string(value, valueLength)));
+                    if (page.size() >= limit)
+                    {
+                        found = true;
+                        proceed = visitor(page);
+                        page.clear();
+                    }
+                    return proceed;
+                });
+    if (proceed && !page.empty())
+    {
+        found = true;
+        visitor(page);
+    }
+    return found;
+}
+
+inline bool SnapshotProvider::isOpen() const
+{
+    return data_ != nullptr;
+}
+
+/**
+ * @brief Returns number of keys
+ */
+inline std::size_t SnapshotProvider::size() const
+{
+    return header_ != nullptr ? static_cast<std::size_t>(header_->count) : 0;
+}
+
+/**
+ * @brief Looks up an exact key
+ *
+ * @param [out] value - the value, empty if none
+ * @return true - if the key is in the snapshot, also with an empty value
+ */
+inline bool SnapshotProvider::find(const char *key, std::size_t keyLength, std::string &value) const
+{
+    value.clear();
+    const char *found(nullptr);
+    std::size_t foundLength(0);
+    const char *data(nullptr);
+    std::size_t length(0);
+    if (entryAt(lowerBound(key, keyLength), found, foundLength, data, length) && foundLength == keyLength &&
+        std::memcmp(found, key, keyLength) == 0)
+    {
+        value.assign(data, length);
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Maps the file and validates its header
+ */
+inline bool SnapshotProvider::open(const std::string &path)
+{
+    const int fd(::open(path.c_str(), O_RDONLY | O_CLOEXEC));
+    if (fd < 0)
+    {
+        loggerRef_.error("Failed to open snapshot " + path + ": " + std::strerror(errno));
+        return false;
+    }
+
+    struct stat status;
+    if (fstat(fd, &status) != 0 || status.st_size < static_cast<off_t>(sizeof(SnapshotHeader)))
+    {
+        loggerRef_.error("Snapshot " + path + " is too short");
+        close(fd);
+        return false;
+    }
+
+    size_ = static_cast<std::size_t>(status.st_size);
+    void *mapped = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // the mapping stays valid
+    if (mapped == MAP_FAILED)
+    {
+        loggerRef_.error("Failed to map snapshot " + path + ": " + std::strerror(errno));
+        return false;
+    }
+    data_ = static_cast<const char *>(mapped);
+    header_ = reinterpret_cast<const SnapshotHeader *>(data_);
+
+    const SnapshotHeader &header = *header_;
+    if (std::memcmp(header.magic, "TLSNAP01", sizeof(header.magic)) != 0 || header.fileSize != size_ ||
+        header.indexOffset % alignof(SnapshotEntry) != 0 || header.indexOffset > size_ ||
+        header.count > (size_ - header.indexOffset) / sizeof(SnapshotEntry) ||
+        header.indexOffset + header.count * sizeof(SnapshotEntry) > header.keysOffset ||
+        header.keysOffset > header.valuesOffset || header.valuesOffset > size_)
+    {
+        loggerRef_.error("Snapshot " + path + " is not a valid snapshot");
+        return false;
+    }
+    entries_ = reinterpret_cast<const SnapshotEntry *>(data_ + header.indexOffset);
+    loggerRef_.trace("Mapped snapshot " + path + " with " + std::to_string(header.count) + " keys");
+    return true;
+}
+
+/**
+ * @brief Resolves an index entry, checking it lies within its region
+ *
+ * @return false - if there is no such entry or it is out of bounds
+ */
+inline bool SnapshotProvider::entryAt(std::size_t index, const char *&key, std::size_t &keyLength,
+                                      const char *&value, std::size_t &valueLength) const
+{
+    if (header_ == nullptr || index >= header_->count)
+    {
+        return false;
+    }
+    const SnapshotEntry &entry = entries_[index];
+    const std::uint64_t keysSize(header_->valuesOffset - header_->keysOffset);
+    const std::uint64_t valuesSize(header_->fileSize - header_->valuesOffset);
+    if (entry.keyOffset > keysSize || entry.keyLength > keysSize - entry.keyOffset ||
+        entry.valueOffset > valuesSize || entry.valueLength > valuesSize - entry.valueOffset)
+    {
+        return false;
+    }
+    key = data_ + header_->keysOffset + entry.keyOffset;
+    keyLength = entry.keyLength;
+    value = data_ + header_->valuesOffset + entry.valueOffset;
+    valueLength = entry.valueLength;
+    return true;
+}
+
+/**
+ * @brief Returns the index of the first key not less than the given one
+ */
+inline std::size_t SnapshotProvider::lowerBound(const char *key, std::size_t keyLength) const
+{
+    std::size_t low(0);
+    std::size_t high(size());
+    while (low < high)
+    {
+        const std::size_t middle(low + (high - low) / 2);
+        const char *found(nullptr);
+        std::size_t foundLength(0);
+        const char *value(nullptr);
+        std::size_t valueLength(0);
+        if (!entryAt(middle, found, foundLength, value, valueLength))
+        {
+            return size(); // corrupt entry: treat as not found
+        }
+        const int order(std::memcmp(found, key, std::min(foundLength, keyLength)));
+        if (order < 0 || (order == 0 && foundLength < keyLength))
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+/**
+ * @brief Visits pairs with a key prefix in key order until the visitor returns false
+ */
+template <class PairVisitor>
+void SnapshotProvider::visitPrefix(const std::string &prefix, PairVisitor visit) const
+{
+    const char *key(nullptr);
+    std::size_t keyLength(0);
+    const char *value(nullptr);
+    std::size_t valueLength(0);
+    for (std::size_t index = lowerBound(prefix.data(), prefix.size());
+         entryAt(index, key, keyLength, value, valueLength) && keyLength >= prefix.size() &&
+         std::memcmp(key, prefix.data(), prefix.size()) == 0;
+         ++index)
+    {
+        if (valueLength > 0 && !visit(key, keyLength, value, valueLength))
+        {
+            return;
+        }
+    }
+}
+
+/**
+ *   \brief  SnapshotWriter streams pairs already in key order into a snapshot file
+ *
+ *   \details The totals are declared up front, so the index, keys and values
+ *            regions are each written at their own offset as pairs come,
+ *            with memory for three buffers whatever the snapshot size. The
+ *            temporary file is synced and replaces the target atomically on
+ *            commit(), an uncommitted one is removed.
+ */
+class SnapshotWriter
+{
+  public:
+    SnapshotWriter();
+    virtual ~SnapshotWriter();
+
+    bool open(const std::string &path, std::uint64_t count, std::uint64_t keysSize, std::uint64_t valuesSize);
+    bool add(const char *key, std::size_t keyLength, const char *value, std::size_t valueLength);
+    bool commit();
+
+  private:
+    SnapshotWriter(const SnapshotWriter &other) = delete;
+    SnapshotWriter(const SnapshotWriter &&other) = delete;
+    SnapshotWriter &operator=(const SnapshotWriter &other) = delete;
+    SnapshotWriter &operator=(const SnapshotWriter &&other) = delete;
+
+    static const std::size_t bufferBytes = 64 * 1024;
+
+    struct Region
+    {
+        std::uint64_t offset; // in the file, of the buffer start
+        std::string buffer;
+    };
+
+    bool put(Region &region, const char *data, std::size_t length);
+    bool drain(Region &region);
+    void abandon();
+
+  private:
+    std::string path_;
+    std::string temporary_;
+    int fd_;
+    SnapshotHeader header_;
+    std::uint64_t added_;
+    std::uint64_t keysSize_; // declared
+    std::uint64_t valuesSize_;
+    std::uint64_t keysAdded_;
+    std::uint64_t valuesAdded_;
+    Region index_;
+    Region keys_;
+    Region values_;
+};
+
+inline SnapshotWriter::SnapshotWriter()
+    : fd_(-1), added_(0), keysSize_(0), valuesSize_(0), keysAdded_(0), valuesAdded_(0)
+{
+    std::memset(&header_, 0, sizeof(header_));
+}
+
+inline SnapshotWriter::~SnapshotWriter()
+{
+    abandon();
+}
+
+/**
+ * @brief Starts a snapshot
+ *
+ * @param path - the target, replaced on commit()
+ * @param count - number of pairs to be added
+ * @param keysSize - their total key length
+ * @param valuesSize - their total value length
+ * @return true - if succeded, false - otherwise
+ */
+inline bool SnapshotWriter::open(const std::string &path, std::uint64_t count, std::uint64_t keysSize,
+                                 std::uint64_t valuesSize)
+{
+    abandon();
+    path_ = path;
+    temporary_ = path + ".tmp";
+    fd_ = ::open(temporary_.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd_ < 0)
+    {
+        return false;
+    }
+
+    std::memset(&header_, 0, sizeof(header_));
+    std::memcpy(header_.magic, "TLSNAP01", sizeof(header_.magic));
+    header_.count = count;
+    header_.indexOffset = sizeof(SnapshotHeader);
+    header_.keysOffset = header_.indexOffset + count * sizeof(SnapshotEntry);
+    header_.valuesOffset = (header_.keysOffset + keysSize + 7) & ~std::uint64_t(7);
+    header_.fileSize = header_.valuesOffset + valuesSize;
+    added_ = 0;
+    keysSize_ = keysSize;
+    valuesSize_ = valuesSize;
+    keysAdded_ = 0;
+    valuesAdded_ = 0;
+    index_.offset = header_.indexOffset;
+    keys_.offset = header_.keysOffset;
+    values_.offset = header_.valuesOffset;
+    index_.buffer.clear();
+    keys_.buffer.clear();
+    values_.buffer.clear();
+    return true;
+}
+
+/**
+ * @brief Adds the next pair, its key greater than the previous one
+ *
+ * @return false - if it exceeds the declared totals or could not be written
+ */
+inline bool SnapshotWriter::add(const char *key, std::size_t keyLength, const char *value, std::size_t valueLength)
+{
+    if (fd_ < 0 || added_ >= header_.count || keyLength > UINT32_MAX || valueLength > UINT32_MAX ||
+        keyLength > keysSize_ - keysAdded_ || valueLength > valuesSize_ - valuesAdded_)
+    {
+        return false;
+    }
+
+    SnapshotEntry entry;
+    entry.keyOffset = keysAdded_;
+    entry.valueOffset = valuesAdded_;
+    entry.keyLength = static_cast<std::uint32_t>(keyLength);
+    entry.valueLength = static_cast<std::uint32_t>(valueLength);
+    ++added_;
+    keysAdded_ += keyLength;
+    valuesAdded_ += valueLength;
+    return put(index_, reinterpret_cast<const char *>(&entry), sizeof(entry)) && put(keys_, key, keyLength) &&
+           put(values_, value, valueLength);
+}
+
+/**
+ * @brief Completes the snapshot: syncs it and replaces the target
+ *
+ * @return false - if fewer pairs were added than declared or it could not be written
+ */
+inline bool SnapshotWriter::commit()
+{
+    if (fd_ < 0 || added_ != header_.count || keysAdded_ != keysSize_ || valuesAdded_ != valuesSize_)
+    {
+        abandon();
+        return false;
+    }
+    if (!drain(index_) || !drain(keys_) || !drain(values_) ||
+        pwrite(fd_, &header_, sizeof(header_), 0) != static_cast<ssize_t>(sizeof(header_)) ||
+        ftruncate(fd_, static_cast<off_t>(header_.fileSize)) != 0 || fsync(fd_) != 0)
+    {
+        abandon();
+        return false;
+    }
+    close(fd_);
+    fd_ = -1;
+    if (std::rename(temporary_.c_str(), path_.c_str()) != 0)
+    {
+        std::remove(temporary_.c_str());
+        return false;
+    }
+
+    // Make the rename durable
+    const std::string::size_type slash(path_.find_last_of('/'));
+    const std::string directory(slash == std::string::npos ? std::string(".") : path_.substr(0, slash + 1));
+    const int fd(::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+    if (fd < 0)
+    {
+        return false;
+    }
+    const bool synced(fsync(fd) == 0);
+    close(fd);
+    return synced;
+}
+
+inline bool SnapshotWriter::put(Region &region, const char *data, std::size_t length)
+{
+    region.buffer.append(data, length);
+    return region.buffer.size() < bufferBytes || drain(region);
+}
+
+inline bool SnapshotWriter::drain(Region &region)
+{
+    std::size_t written(0);
+    while (written < region.buffer.size())
+    {
+        const ssize_t result(pwrite(fd_, region.buffer.data() + written, region.buffer.size() - written,
+                                    static_cast<off_t>(region.offset + written)));
+        if (result < 0 && errno != EINTR)
+        {
+            return false;
+        }
+        written += result > 0 ? static_cast<std::size_t>(result) : 0;
+    }
+    region.offset += written;
+    region.buffer.clear();
+    return true;
+}
+
+inline void SnapshotWriter::abandon()
+{
+    if (fd_ >= 0)
+    {
+        close(fd_);
+        fd_ = -1;
+        std::remove(temporary_.c_str());
+    }
+}
+
+/**
+ *   \brief  SnapshotBuilder writes snapshot files for SnapshotProvider
+ *
+ *   \details Pairs are collected in memory, then sorted and written to a
+ *            temporary file which is synced and replaces the target
+ *            atomically, so after a crash the target is either the old or
+ *            the complete new file, and a running SnapshotProvider of the
+ *            old file is not disturbed.
+ */
+class SnapshotBuilder
+{
+  public:
+    explicit SnapshotBuilder(bool keepEmpty = false);
+    virtual ~SnapshotBuilder();
+
+    void add(const std::string &key, const std::string &value);
+    void add(std::string &&key, std::string &&value);
+    std::size_t size() const;
+    bool write(const std::string &path);
+
+    static bool build(IPairWrittable &source, const std::string &key, const std::string &path,
+                      std::size_t pageSize = 1024);
+
+  private:
+    SnapshotBuilder(const SnapshotBuilder &other) = delete;
+    SnapshotBuilder(const SnapshotBuilder &&other) = delete;
+    SnapshotBuilder &operator=(const SnapshotBuilder &other) = delete;
+    SnapshotBuilder &operator=(const SnapshotBuilder &&other) = delete;
+
+  private:
+    std::vector<KeyValuePair> pairs_;
+    const bool keepEmpty_;
+};
+
+/**
+ * @brief Constructor
+ *
+ * @param keepEmpty - whether empty values are written, e.g. as tombstones
+ */
+inline SnapshotBuilder::SnapshotBuilder(bool keepEmpty) : keepEmpty_(keepEmpty)
+{
+}
+
+inline SnapshotBuilder::~SnapshotBuilder()
+{
+}
+
+/**
+ * @brief Adds a pair, a later pair of the same key wins, an empty value is skipped unless kept
+ */
+inline void SnapshotBuilder::add(const std::string &key, const std::string &value)
+{
+    if (keepEmpty_ || !value.empty())
+    {
+        pairs_.push_back(KeyValuePair(key, value));
+    }
+}
+
+inline void SnapshotBuilder::add(std::string &&key, std::string &&value)
+{
+    if (keepEmpty_ || !value.empty())
+    {
+        pairs_.push_back(KeyValuePair(std::move(key), std::move(value)));
+    }
+}
+
+/**
+ * @brief Returns number of pairs added
+ */
+inline std::size_t SnapshotBuilder::size() const
+{
+    return pairs_.size();
+}
+
+/**
+ * @brief Writes the snapshot
+ *
+ * @param path - the target, replaced atomically
+ * @return true - if succeded, false - otherwise
+ */
+inline bool SnapshotBuilder::write(const std::string &path)
+{
+    std::stable_sort(pairs_.begin(), pairs_.end(),
+                     [](const KeyValuePair &left, const KeyValuePair &right) { return left.key < right.key; });
+
+    // Keep the last pair of each key
+    std::size_t kept(0);
+    for (std::size_t index = 0; index < pairs_.size(); ++index)
+    {
+        if (index + 1 < pairs_.size() && pairs_[index + 1].key == pairs_[index].key)
+        {
+            continue;
+        }
+        if (kept != index)
+        {
+            pairs_[kept] = std::move(pairs_[index]);
+        }
+        ++kept;
+    }
+    pairs_.erase(pairs_.begin() + kept, pairs_.end());
+
+    std::uint64_t keysSize(0);
+    std::uint64_t valuesSize(0);
+    for (const KeyValuePair &pair : pairs_)
+    {
+        keysSize += pair.key.size();
+        valuesSize += pair.value.size();
+    }
+
+    SnapshotWriter writer;
+    if (!writer.open(path, pairs_.size(), keysSize, valuesSize))
+    {
+        return false;
+    }
+    for (const KeyValuePair &pair : pairs_)
+    {
+        if (!writer.add(pair.key.data(), pair.key.size(), pair.value.data(), pair.value.size()))
+        {
+            return false;
+        }
+    }
+    return writer.commit();
+}
+
+/**
+ * @brief Writes a snapshot of all pairs of a key in a provider, e.g. everything in redis
+ *
+ * @param source - a provider, read page by page through visitPages()
+ * @param key - a key (can have "\*" notation, "\*" for all keys)
+ * @param path - the target, replaced atomically
+ * @param pageSize - pairs read per page
+ * @return true - if succeded, false - otherwise. Providers report a failure
+ *         and no match alike, so neither replaces the snapshot at path; write
+ *         an empty SnapshotBuilder to get an empty snapshot.
+ */
+inline bool SnapshotBuilder::build(IPairWrittable &source, const std::string &key, const std::string &path,
+                                   std::size_t pageSize)
+{
+    SnapshotBuilder builder;
+    const bool found(source.visitPages(key, pageSize, [&builder](std::vector<KeyValuePair> &page) {
+        for (KeyValuePair &pair : page)
+        {
+            builder.add(std::move(pair.key), std::move(pair.value));
+        }
+        return true;
+    }));
+    return found && builder.write(path);
+}
+}
@@ -0,0 +1,122 @@
+// MIT License
+// 
+// Copyright(c) 2018 Alex Tversky
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#pragma once
+
+#include <string>
+#include <vector>
+
+#if defined(__linux__)
+#include <pthread.h>      // pthread_setaffinity_np, pthread_setname_np
+#include <sched.h>        // SCHED_FIFO, cpu_set_t
+#include <sys/resource.h> // setpriority
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace Util
+{
+/**
+ *  \brief  Scheduling policy of a callback thread
+ *
+ *  \details  TP_DEFAULT - time sharing (SCHED_OTHER) with an optional nice level,
+ *            TP_FIFO - real time SCHED_FIFO (needs CAP_SYS_NICE or an RLIMIT_RTPRIO),
+ *            TP_ROUND_ROBIN - real time SCHED_RR
+ */
+enum ThreadPolicy
+{
+    TP_DEFAULT = 0,
+    TP_FIFO = 1,
+    TP_ROUND_ROBIN = 2
+};
+
+/**
+ *  \brief ThreadOptions - name, CPU affinity and scheduling of a callback thread
+ */
+struct ThreadOptions
+{
+    ThreadOptions() : policy(TP_DEFAULT), priority(0), nice(0)
+    {
+    }
+
+    std::string name;      // shown by top/ps/gdb, truncated to 15 characters
+    std::vector<int> cpus; // CPUs the thread may run on, empty for any
+    ThreadPolicy policy;
+    int priority;          // real time priority 1..99 for TP_FIFO and TP_ROUND_ROBIN
+    int nice;              // nice level -20..19 for TP_DEFAULT, 0 keeps the inherited one
+};
+
+/**
+ * @brief Applies thread options to the calling thread
+ *
+ * @param options - thread options
+ * @return false - if any option could not be applied (the others still are),
+ *         e.g. a real time policy without the privilege; always false but for Linux
+ */
+inline bool applyThreadOptions(const ThreadOptions &options)
+{
+#if defined(__linux__)
+    bool applied(true);
+    const pthread_t self(pthread_self());
+
+    if (!options.name.empty())
+    {
+        const std::string name(options.name.substr(0, 15)); // 16 bytes with the terminator
+        applied = pthread_setname_np(self, name.c_str()) == 0 && applied;
+    }
+
+    if (!options.cpus.empty())
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu : options.cpus)
+        {
+            if (cpu >= 0 && cpu < CPU_SETSIZE)
+            {
+                CPU_SET(cpu, &set);
+            }
+        }
+        applied = pthread_setaffinity_np(self, sizeof(set), &set) == 0 && applied;
+    }
+
+    if (options.policy == TP_DEFAULT)
+    {
+        if (options.nice != 0)
+        {
+            // On Linux a nice level belongs to the thread, addressed by its kernel id
+            const id_t thread(static_cast<id_t>(syscall(SYS_gettid)));
+            applied = setpriority(PRIO_PROCESS, thread, options.nice) == 0 && applied;
+        }
+    }
+    else
+    {
+        sched_param param = {};
+        param.sched_priority = options.priority;
+        applied = pthread_setschedparam(self, options.policy == TP_FIFO ? SCHED_FIFO : SCHED_RR,
+                                        &param) == 0 && applied;
+    }
+    return applied;
+#else
+    (void)options;
+    return false;
+#endif
+}
+}
@@ -0,0 +1,324 @@
+// MIT License
+// 
+// Copyright(c) 2018 Alex Tversky
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#pragma once
+
+#include "Util/IPairWrittable.hpp"
+#include <string>
+#include <vector>
+
+namespace Util
+{
+/**
+ *  @brief Roles of a tier, combined as flags
+ */
+enum TierFlags
+{
+    TF_READ = 1,    // consulted by getters
+    TF_WRITE = 2,   // receives setters
+    TF_PROMOTE = 4  // receives values found in slower tiers (and refreshed by setters)
+};
+
+/**
+ *  \brief TieredPairWrittable - several providers consulted in priority order
+ *
+ *  \details Tiers are added fastest first, e.g. memory, then a JSON file,
+ *           then Redis. A getter returns the answer of the first tier which
+ *           has the key and copies it into faster TF_PROMOTE tiers. Setters
+ *           write to TF_WRITE tiers slowest first, so a faster tier never
+ *           holds a value a slower one rejected, then refresh TF_PROMOTE
+ *           tiers. Tiers must be added before use and outlive this object;
+ *           thread safety is that of the tiers.
+ */
+class TieredPairWrittable : public IPairWrittable
+{
+  public:
+    using IPairWrittable::getValue;
+    using IPairWrittable::setValue;
+
+    TieredPairWrittable();
+    virtual ~TieredPairWrittable();
+
+    void addTier(IPairWrittable &tier, unsigned flags = TF_READ);
+    std::size_t tierCount() const;
+
+    bool getKeyValue(const std::string &key, std::vector<KeyValuePair> &values) override;
+    bool getValue(const std::string &key, std::vector<std::string> &values) override;
+    bool setValue(const std::string &key, const std::string &value) override;
+    bool getValues(const std::vector<std::string> &keys, std::vector<std::string> &values) override;
+    bool setValues(const std::vector<KeyValuePair> &pairs) override;
+    bool getValue(const char *key, std::size_t keyLength, std::string &value) override;
+    bool setValue(const char *key, std::size_t keyLength, const char *value, std::size_t valueLength) override;
+    bool visitPages(const std::string &key, std::size_t pageSize, const PageVisitor &visitor) override;
+
+  private:
+    TieredPairWrittable(const TieredPairWrittable &other) = delete;
+    TieredPairWrittable(const TieredPairWrittable &&other) = delete;
+    TieredPairWrittable &operator=(const TieredPairWrittable &other) = delete;
+    TieredPairWrittable &operator=(const TieredPairWrittable &&other) = delete;
+
+    struct Tier
+    {
+        IPairWrittable *provider;
+        unsigned flags;
+    };
+
+    static bool isWildcard(const std::string &key);
+
+  private:
+    std::vector<Tier> tiers_;
+};
+
+inline TieredPairWrittable::TieredPairWrittable()
+{
+}
+
+inline TieredPairWrittable::~TieredPairWrittable()
+{
+}
+
+/**
+ * @brief Adds a tier slower than all added before
+ *
+ * @param tier - a provider, must outlive this object
+ * @param flags - TierFlags combined
+ */
+inline void TieredPairWrittable::addTier(IPairWrittable &tier, unsigned flags)
+{
+    Tier entry;
+    entry.provider = &tier;
+    entry.flags = flags;
+    tiers_.push_back(entry);
+}
+
+inline std::size_t TieredPairWrittable::tierCount() const
+{
+    return tiers_.size();
+}
+
+/**
+ * @brief Retrieves key/value pairs from the first tier which has them, without promotion
+ */
+inline bool TieredPairWrittable::getKeyValue(const std::string &key, std::vector<KeyValuePair> &values)
+{
+    for (const Tier &tier : tiers_)
+    {
+        if ((tier.flags & TF_READ) && tier.provider->getKeyValue(key, values))
+        {
+            return true;
+        }
+    }
+    values.clear();
+    return false;
+}
+
+/**
+ * @brief Streams key/value pairs from the first tier which has them, without promotion
+ */
+inline bool TieredPairWrittable::visitPages(const std::string &key, std::size_t pageSize,
+                                           const PageVisitor &visitor)
+{
+    for (const Tier &tier : tiers_)
+    {
+        if ((tier.flags & TF_READ) && tier.provider->visitPages(key, pageSize, visitor))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Retrieves value/s from the first tier which has them.
+ *        A single value of an exact key is promoted into faster tiers.
+ */
+inline bool TieredPairWrittable::getValue(const std::string &key, std::vector<std::string> &values)
+{
+    for (std::size_t index = 0; index < tiers_.size(); ++index)
+    {
+        if ((tiers_[index].flags & TF_READ) && tiers_[index].provider->getValue(key, values) && !values.empty())
+        {
+            if (!isWildcard(key))
+            {
+                for (std::size_t faster = 0; faster < index; ++faster)
+                {
+                    if (tiers_[faster].flags & TF_PROMOTE)
+                    {
+                        tiers_[faster].provider->setValue(key, values[0]);
+                    }
+                }
+            }
+            return true;
+        }
+    }
+    values.clear();
+    return false;
+}
+
+inline bool TieredPairWrittable::getValue(const char *key, std::size_t keyLength, std::string &value)
+{
+    for (std::size_t index = 0; index < tiers_.size(); ++index)
+    {
+        if ((tiers_[index].flags & TF_READ) && tiers_[index].provider->getValue(key, keyLength, value))
+        {
+            for (std::size_t faster = 0; faster < index; ++faster)
+            {
+                if (tiers_[faster].flags & TF_PROMOTE)
+                {
+                    tiers_[faster].provider->setValue(key, keyLength, value.data(), value.size());
+                }
+            }
+            return true;
+        }
+    }
+    value.clear();
+    return false;
+}
+
+/**
+ * @brief Retrieves values of many exact keys, asking each tier only for keys still missing
+ */
+inline bool TieredPairWrittable::getValues(const std::vector<std::string> &keys, std::vector<std::string> &values)
+{
+    resetValues(values, keys.size());
+    std::vector<std::size_t> missing;
+    for (std::size_t index = 0; index < keys.size(); ++index)
+    {
+        missing.push_back(index);
+    }
+
+    std::vector<std::string> tierKeys;
+    std::vector<std::string> tierValues;
+    std::vector<KeyValuePair> found;
+    for (std::size_t index = 0; index < tiers_.size() && !missing.empty(); ++index)
+    {
+        if (!(tiers_[index].flags & TF_READ))
+        {
+            continue;
+        }
+
+        tierKeys.clear();
+        for (std::size_t position : missing)
+        {
+            tierKeys.push_back(keys[position]);
+        }
+        tiers_[index].provider->getValues(tierKeys, tierValues);
+
+        std::vector<std::size_t> stillMissing;
+        found.clear();
+        for (std::size_t slot = 0; slot < missing.size(); ++slot)
+        {
+            if (slot < tierValues.size() && !tierValues[slot].empty())
+            {
+                values[missing[slot]].swap(tierValues[slot]);
+                found.push_back(KeyValuePair(keys[missing[slot]], values[missing[slot]]));
+            }
+            else
+            {
+                stillMissing.push_back(missing[slot]);
+            }
+        }
+        missing.swap(stillMissing);
+
+        for (std::size_t faster = 0; faster < index && !found.empty(); ++faster)
+        {
+            if (tiers_[faster].flags & TF_PROMOTE)
+            {
+                tiers_[faster].provider->setValues(found);
+            }
+        }
+    }
+    return missing.empty();
+}
+
+/**
+ * @brief Sets value in TF_WRITE tiers, slowest first, then refreshes TF_PROMOTE tiers
+ *
+ * @return true - if all TF_WRITE tiers succeded, false - otherwise or if there are none
+ */
+inline bool TieredPairWrittable::setValue(const std::string &key, const std::string &value)
+{
+    return setValue(key.data(), key.size(), value.data(), value.size());
+}
+
+inline bool TieredPairWrittable::setValue(const char *key, std::size_t keyLength,
+                                          const char *value, std::size_t valueLength)
+{
+    bool written(false);
+    bool status(true);
+    for (std::size_t index = tiers_.size(); index-- > 0;)
+    {
+        if ((tiers_[index].flags & TF_WRITE) && status)
+        {
+            status = tiers_[index].provider->setValue(key, keyLength, value, valueLength);
+            written = true;
+        }
+    }
+    if (!written || !status)
+    {
+        return false;
+    }
+
+    for (const Tier &tier : tiers_)
+    {
+        if ((tier.flags & TF_PROMOTE) && !(tier.flags & TF_WRITE))
+        {
+            tier.provider->setValue(key, keyLength, value, valueLength);
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Sets many values in TF_WRITE tiers, slowest first, then refreshes TF_PROMOTE tiers
+ */
+inline bool TieredPairWrittable::setValues(const std::vector<KeyValuePair> &pairs)
+{
+    bool written(false);
+    bool status(true);
+    for (std::size_t index = tiers_.size(); index-- > 0;)
+    {
+        if ((tiers_[index].flags & TF_WRITE) && status)
+        {
+            status = tiers_[index].provider->setValues(pairs);
+            written = true;
+        }
+    }
+    if (!written || !status)
+    {
+        return false;
+    }
+
+    for (const Tier &tier : tiers_)
+    {
+        if ((tier.flags & TF_PROMOTE) && !(tier.flags & TF_WRITE))
+        {
+            tier.provider->setValues(pairs);
+        }
+    }
+    return true;
+}
+
+inline bool TieredPairWrittable::isWildcard(const std::string &key)
+{
+    return !key.empty() && '*' == key.back();
+}
+}
@@ -0,0 +1,263 @@
+// MIT License
+//
+// Copyright(c) 2018 Alex Tversky
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#pragma once
+
+#include "Util/InplaceFunction.hpp"
+#include "Util/TimingWheel.hpp"
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace Util
+{
+/**
+ *  \brief TimeoutWheel - one-shot cancellable timeouts on a hierarchical timing wheel
+ *
+ *  \details Meant for millions of short-lived timeouts, most of them cancelled.
+ *           Timer nodes come from a pool which only grows, so after warm-up
+ *           (or reserve()) arming and cancelling allocate nothing and make no
+ *           system calls. Not thread safe: one owner thread arms, cancels
+ *           and calls poll(), like an event loop.
+ */
+class TimeoutWheel
+{
+  public:
+    typedef std::chrono::steady_clock Clock;
+    typedef InplaceFunction<void()> Callback;
+    typedef std::uint64_t Handle; // 0 is never a valid handle
+
+    explicit TimeoutWheel(std::chrono::microseconds resolution = std::chrono::milliseconds(1));
+    virtual ~TimeoutWheel();
+
+    template <class Rep, class Period>
+    Handle scheduleAfter(const std::chrono::duration<Rep, Period> &timeout, Callback callback);
+    Handle scheduleAt(Clock::time_point deadline, Callback callback);
+    bool cancel(Handle handle);
+
+    std::size_t poll(Clock::time_point now = Clock::now());
+    bool nextExpiry(Clock::time_point &deadline) const;
+
+    void reserve(std::size_t timers);
+    std::size_t size() const;
+
+  private:
+    TimeoutWheel(const TimeoutWheel &other) = delete;
+    TimeoutWheel(const TimeoutWheel &&other) = delete;
+    TimeoutWheel &operator=(const TimeoutWheel &other) = delete;
+    TimeoutWheel &operator=(const TimeoutWheel &&other) = delete;
+
+    static const std::uint32_t chunkSize = 4096;
+    static const std::uint32_t noNode = 0xFFFFFFFFu;
+
+    struct Node : TimingWheelNode
+    {
+        Callback callback;
+        std::uint32_t index;
+        std::uint32_t generation;
+        std::uint32_t nextFree;
+    };
+
+    Node &acquire();
+    void release(Node &node);
+    Node *find(Handle handle);
+    std::uint64_t tickOf(Clock::time_point time) const;
+    std::uint64_t dueTickOf(Clock::time_point time) const;
+
+  private:
+    const Clock::time_point epoch_;
+    const Clock::duration resolution_;
+    TimingWheel wheel_;
+    std::vector<std::unique_ptr<Node[]>> chunks_;
+    std::uint32_t freeHead_;
+};
+
+inline TimeoutWheel::TimeoutWheel(std::chrono::microseconds resolution)
+    : epoch_(Clock::now()),
+      resolution_(std::chrono::duration_cast<Clock::duration>(resolution).count() > 0
+                      ? std::chrono::duration_cast<Clock::duration>(resolution)
+                      : Clock::duration(1)),
+      freeHead_(noNode)
+{
+}
+
+inline TimeoutWheel::~TimeoutWheel()
+{
+}
+
+/**
+ * @brief Arms a timeout
+ *
+ * @param timeout - a delay (rounded up to the wheel resolution)
+ * @param callback - called once from poll() unless cancelled
+ * @return a handle for cancel()
+ */
+template <class Rep, class Period>
+TimeoutWheel::Handle TimeoutWheel::scheduleAfter(const std::chrono::duration<Rep, Period> &timeout,
+                                                 Callback callback)
+{
+    return scheduleAt(Clock::now() + std::chrono::duration_cast<Clock::duration>(timeout),
+                      std::move(callback));
+}
+
+/**
+ * @brief Arms a timeout at an absolute deadline
+ */
+inline TimeoutWheel::Handle TimeoutWheel::scheduleAt(Clock::time_point deadline, Callback callback)
+{
+    Node &node = acquire();
+    node.callback = std::move(callback);
+    wheel_.insert(node, tickOf(deadline));
+    return (std::uint64_t(node.generation) << 32) | node.index;
+}
+
+/**
+ * @brief Disarms a timeout in O(1)
+ *
+ * @return false - if the timeout already fired or was cancelled
+ */
+inline bool TimeoutWheel::cancel(Handle handle)
+{
+    Node *node = find(handle);
+    if (node == nullptr)
+    {
+        return false;
+    }
+    wheel_.remove(*node);
+    release(*node);
+    return true;
+}
+
+/**
+ * @brief Runs callbacks of all timeouts due at the given time
+ *
+ * @return number of callbacks run
+ */
+inline std::size_t TimeoutWheel::poll(Clock::time_point now)
+{
+    std::size_t fired(0);
+    wheel_.advance(dueTickOf(now), [this, &fired](TimingWheelNode &expired) {
+        // Release first: the callback may arm or cancel other timeouts
+        Node &node = static_cast<Node &>(expired);
+        Callback callback(std::move(node.callback));
+        release(node);
+        callback();
+        ++fired;
+    });
+    return fired;
+}
+
+/**
+ * @brief Returns a time by which poll() should be called next
+ *
+ * @return false - if no timeout is armed
+ */
+inline bool TimeoutWheel::nextExpiry(Clock::time_point &deadline) const
+{
+    std::uint64_t tick(0);
+    if (!wheel_.nextExpiry(tick))
+    {
+        return false;
+    }
+    deadline = epoch_ + resolution_ * static_cast<Clock::rep>(tick);
+    return true;
+}
+
+/**
+ * @brief Pre-allocates timer nodes, so arming never allocates
+ */
+inline void TimeoutWheel::reserve(std::size_t timers)
+{
+    while (chunks_.size() * chunkSize < timers)
+    {
+        const std::uint32_t base(static_cast<std::uint32_t>(chunks_.size() * chunkSize));
+        chunks_.push_back(std::unique_ptr<Node[]>(new Node[chunkSize]));
+        Node *chunk = chunks_.back().get();
+        for (std::uint32_t offset = chunkSize; offset-- > 0;)
+        {
+            chunk[offset].index = base + offset;
+            chunk[offset].generation = 1;
+            chunk[offset].nextFree = freeHead_;
+            freeHead_ = base + offset;
+        }
+    }
+}
+
+inline std::size_t TimeoutWheel::size() const
+{
+    return static_cast<std::size_t>(wheel_.size());
+}
+
+inline TimeoutWheel::Node &TimeoutWheel::acquire()
+{
+    if (freeHead_ == noNode)
+    {
+        reserve((chunks_.size() + 1) * chunkSize);
+    }
+    Node &node = chunks_[freeHead_ / chunkSize][freeHead_ % chunkSize];
+    freeHead_ = node.nextFree;
+    node.nextFree = noNode;
+    return node;
+}
+
+inline void TimeoutWheel::release(Node &node)
+{
+    node.callback = nullptr;
+    ++node.generation;
+    if (node.generation == 0)
+    {
+        node.generation = 1;
+    }
+    node.nextFree = freeHead_;
+    freeHead_ = node.index;
+}
+
+inline TimeoutWheel::Node *TimeoutWheel::find(Handle handle)
+{
+    const std::uint32_t index(static_cast<std::uint32_t>(handle & 0xFFFFFFFFu));
+    const std::uint32_t generation(static_cast<std::uint32_t>(handle >> 32));
+    if (generation == 0 || index / chunkSize >= chunks_.size())
+    {
+        return nullptr;
+    }
+    Node &node = chunks_[index / chunkSize][index % chunkSize];
+    return (node.generation == generation && node.linked()) ? &node : nullptr;
+}
+
+inline std::uint64_t TimeoutWheel::tickOf(Clock::time_point time) const
+{
+    if (time <= epoch_)
+    {
+        return 0;
+    }
+    return static_cast<std::uint64_t>((time - epoch_ + resolution_ - Clock::duration(1)) / resolution_);
+}
+
+inline std::uint64_t TimeoutWheel::dueTickOf(Clock::time_point time) const
+{
+    if (time <= epoch_)
+    {
+        return 0;
+    }
+    return static_cast<std::uint64_t>((time - epoch_) / resolution_);
+}
+}
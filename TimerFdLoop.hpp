@@ -0,0 +1,450 @@
+// MIT License
+//
+// Copyright(c) 2018 Alex Tversky
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#pragma once
+
+#include "Util/InplaceFunction.hpp"
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+#include <sys/epoll.h>   // Linux only
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+namespace Util
+{
+/**
+ *  \brief TimerFdLoop - timers and file descriptors multiplexed on one epoll thread
+ *
+ *  \details Every timer is a timerfd armed with an absolute CLOCK_MONOTONIC
+ *           deadline (the clock behind std::chrono::steady_clock on Linux), so
+ *           wakeups are as precise as the kernel allows and periodic timers
+ *           do not drift. Callbacks run on the loop thread with the loop
+ *           locked: adding or removing from another thread waits for a running
+ *           callback, adding or removing from a callback is allowed.
+ */
+class TimerFdLoop
+{
+  public:
+    typedef std::uint64_t Id;
+    typedef InplaceFunction<void()> Callback;
+    typedef InplaceFunction<void(std::uint32_t)> FdCallback;
+
+    TimerFdLoop();
+    virtual ~TimerFdLoop();
+
+    bool start();
+    void stop();
+    bool isRunning() const;
+
+    Id addTimer(std::chrono::steady_clock::time_point deadline,
+                std::chrono::nanoseconds period, Callback callback);
+    Id addTimer(std::chrono::nanoseconds period, Callback callback);
+    Id watch(int fd, std::uint32_t events, FdCallback callback);
+    bool remove(Id id);
+
+  private:
+    TimerFdLoop(const TimerFdLoop &other) = delete;
+    TimerFdLoop(const TimerFdLoop &&other) = delete;
+    TimerFdLoop &operator=(const TimerFdLoop &other) = delete;
+    TimerFdLoop &operator=(const TimerFdLoop &&other) = delete;
+
+    struct Entry
+    {
+        int fd;
+        bool timer;
+        bool oneShot;
+        bool removed;
+        Callback callback;
+        FdCallback fdCallback;
+    };
+
+    Id add(std::unique_ptr<Entry> entry, std::uint32_t events);
+    void erase(Id id);
+    void run();
+    bool proceed();
+    void wake();
+    void dispatch(Id id, std::uint32_t events);
+
+    static timespec toTimespec(std::chrono::nanoseconds value);
+
+  private:
+    const int epollFd_;
+    const int wakeFd_;
+    std::atomic<bool> execute_;
+    std::thread thread_;
+    std::mutex lifecycleMutex_;     // serializes start() and stop() from other threads, guards thread_
+    mutable std::mutex stateMutex_; // guards exited_, stopping_, loopThread_ and the loop's exit
+    bool exited_;
+    bool stopping_;
+    std::thread::id loopThread_;
+    std::unordered_map<Id, std::unique_ptr<Entry>> entries_;
+    Id lastId_;
+    Id current_;
+    std::recursive_mutex mutex_;
+};
+
+inline TimerFdLoop::TimerFdLoop()
+    : epollFd_(epoll_create1(EPOLL_CLOEXEC)), wakeFd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)),
+      execute_(false), exited_(true), stopping_(false), lastId_(0), current_(0)
+{
+    if (epollFd_ >= 0 && wakeFd_ >= 0)
+    {
+        epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.u64 = 0; // reserved for wake-ups
+        epoll_ctl(epollFd_, EPOLL_CTL_ADD, wakeFd_, &event);
+    }
+}
+
+inline TimerFdLoop::~TimerFdLoop()
+{
+    stop();
+    for (auto &entry : entries_)
+    {
+        if (entry.second->timer)
+        {
+            close(entry.second->fd);
+        }
+    }
+    if (wakeFd_ >= 0)
+    {
+        close(wakeFd_);
+    }
+    if (epollFd_ >= 0)
+    {
+        close(epollFd_);
+    }
+}
+
+/**
+ * @brief Starts the loop thread
+ *
+ * @return false - if epoll or eventfd could not be created
+ */
+inline bool TimerFdLoop::start()
+{
+    if (epollFd_ < 0 || wakeFd_ < 0)
+    {
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> state(stateMutex_);
+        if (loopThread_ == std::this_thread::get_id())
+        {
+            // restarted from a callback: the loop goes on, unless a stop() is joining it
+            if (!stopping_)
+            {
+                execute_.store(true);
+            }
+            return !stopping_;
+        }
+    }
+    std::lock_guard<std::mutex> lifecycle(lifecycleMutex_);
+    {
+        std::lock_guard<std::mutex> state(stateMutex_);
+        if (!exited_)
+        {
+            execute_.store(true); // running, or stopped from a callback and not returned yet
+            return true;
+        }
+    }
+    if (thread_.joinable())
+    {
+        thread_.join(); // the loop returned after a stop from a callback
+    }
+    {
+        std::lock_guard<std::mutex> state(stateMutex_);
+        exited_ = false;
+        execute_.store(true);
+    }
+    thread_ = std::thread(&TimerFdLoop::run, this);
+    return true;
+}
+
+/**
+ * @brief Stops the loop thread, timers and watches stay registered.
+ *        From a callback it only requests the stop: the loop returns
+ *        after the callback and is joined by the next stop() or start().
+ */
+inline void TimerFdLoop::stop()
+{
+    {
+        std::lock_guard<std::mutex> state(stateMutex_);
+        execute_.store(false);
+        if (loopThread_ == std::this_thread::get_id())
+        {
+            return;
+        }
+    }
+    std::lock_guard<std::mutex> lifecycle(lifecycleMutex_);
+    {
+        std::lock_guard<std::mutex> state(stateMutex_);
+        execute_.store(false); // a start() may have come in between
+        stopping_ = true;
+    }
+    if (thread_.joinable())
+    {
+        wake();
+        thread_.join();
+    }
+    std::lock_guard<std::mutex> state(stateMutex_);
+    stopping_ = false;
+}
+
+inline bool TimerFdLoop::isRunning() const
+{
+    std::lock_guard<std::mutex> state(stateMutex_);
+    return execute_.load() && !exited_;
+}
+
+/**
+ * @brief Adds a timer firing at an absolute deadline
+ *
+ * @param deadline - the first expiry
+ * @param period - the period of a periodic timer, zero for a one-shot timer
+ * @param callback - a callback run on the loop thread
+ * @return a timer id, 0 on failure
+ */
+inline TimerFdLoop::Id TimerFdLoop::addTimer(std::chrono::steady_clock::time_point deadline,
+                                             std::chrono::nanoseconds period, Callback callback)
+{
+    const int fd(timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC));
+    if (fd < 0)
+    {
+        return 0;
+    }
+
+    itimerspec spec = {};
+    spec.it_value = toTimespec(std::chrono::duration_cast<std::chrono::nanoseconds>(deadline.time_since_epoch()));
+    spec.it_interval = toTimespec(period);
+    if (spec.it_value.tv_sec == 0 && spec.it_value.tv_nsec == 0)
+    {
+        spec.it_value.tv_nsec = 1; // zero would disarm the timer
+    }
+    if (timerfd_settime(fd, TFD_TIMER_ABSTIME, &spec, nullptr) != 0)
+    {
+        close(fd);
+        return 0;
+    }
+
+    std::unique_ptr<Entry> entry(new Entry());
+    entry->fd = fd;
+    entry->timer = true;
+    entry->oneShot = period.count() <= 0;
+    entry->removed = false;
+    entry->callback = std::move(callback);
+    return add(std::move(entry), EPOLLIN);
+}
+
+/**
+ * @brief Adds a periodic timer, first firing one period from now
+ */
+inline TimerFdLoop::Id TimerFdLoop::addTimer(std::chrono::nanoseconds period, Callback callback)
+{
+    return addTimer(std::chrono::steady_clock::now() + period, period, std::move(callback));
+}
+
+/**
+ * @brief Watches a file descriptor owned by the caller
+ *
+ * @param fd - a file descriptor, must stay open until removed
+ * @param events - epoll events, e.g. EPOLLIN
+ * @param callback - a callback run on the loop thread with the ready events
+ * @return a watch id, 0 on failure
+ */
+inline TimerFdLoop::Id TimerFdLoop::watch(int fd, std::uint32_t events, FdCallback callback)
+{
+    std::unique_ptr<Entry> entry(new Entry());
+    entry->fd = fd;
+    entry->timer = false;
+    entry->oneShot = false;
+    entry->removed = false;
+    entry->fdCallback = std::move(callback);
+    return add(std::move(entry), events);
+}
+
+/**
+ * @brief Removes a timer or a watch
+ *
+ * @return false - if there is no such id
+ */
+inline bool TimerFdLoop::remove(Id id)
+{
+    std::lock_guard<std::recursive_mutex> guard(mutex_);
+    auto found = entries_.find(id);
+    if (found == entries_.end() || found->second->removed)
+    {
+        return false;
+    }
+
+    epoll_ctl(epollFd_, EPOLL_CTL_DEL, found->second->fd, nullptr);
+    if (id == current_)
+    {
+        found->second->removed = true; // erased once its callback returns
+    }
+    else
+    {
+        erase(id);
+    }
+    return true;
+}
+
+inline TimerFdLoop::Id TimerFdLoop::add(std::unique_ptr<Entry> entry, std::uint32_t events)
+{
+    std::lock_guard<std::recursive_mutex> guard(mutex_);
+    const Id id(++lastId_);
+
+    epoll_event event = {};
+    event.events = events;
+    event.data.u64 = id;
+    if (epoll_ctl(epollFd_, EPOLL_CTL_ADD, entry->fd, &event) != 0)
+    {
+        if (entry->timer)
+        {
+            close(entry->fd);
+        }
+        return 0;
+    }
+    entries_[id] = std::move(entry);
+    return id;
+}
+
+inline void TimerFdLoop::erase(Id id)
+{
+    auto found = entries_.find(id);
+    if (found != entries_.end())
+    {
+        if (found->second->timer)
+        {
+            close(found->second->fd);
+        }
+        entries_.erase(found);
+    }
+}
+
+inline void TimerFdLoop::run()
+{
+    const int maxEvents(64);
+    epoll_event events[maxEvents];
+    {
+        std::lock_guard<std::mutex> state(stateMutex_);
+        loopThread_ = std::this_thread::get_id();
+    }
+    while (proceed())
+    {
+        const int count(epoll_wait(epollFd_, events, maxEvents, -1));
+        if (count < 0 && errno != EINTR)
+        {
+            execute_.store(false);
+            continue;
+        }
+        for (int index = 0; index < count && execute_.load(); ++index)
+        {
+            if (events[index].data.u64 == 0)
+            {
+                std::uint64_t value(0);
+                ssize_t received(read(wakeFd_, &value, sizeof(value)));
+                (void)received;
+                continue;
+            }
+            dispatch(events[index].data.u64, events[index].events);
+        }
+    }
+}
+
+/**
+ * @brief Decides under the state lock whether the loop goes on, so
+ *        start() never mistakes a returning loop for a running one
+ */
+inline bool TimerFdLoop::proceed()
+{
+    std::lock_guard<std::mutex> state(stateMutex_);
+    if (execute_.load())
+    {
+        return true;
+    }
+    exited_ = true;
+    loopThread_ = std::thread::id();
+    return false;
+}
+
+inline void TimerFdLoop::wake()
+{
+    const std::uint64_t one(1);
+    ssize_t written(write(wakeFd_, &one, sizeof(one)));
+    (void)written;
+}
+
+inline void TimerFdLoop::dispatch(Id id, std::uint32_t events)
+{
+    std::lock_guard<std::recursive_mutex> guard(mutex_);
+    auto found = entries_.find(id);
+    if (found == entries_.end() || found->second->removed)
+    {
+        return; // removed after epoll_wait returned
+    }
+
+    Entry &entry = *found->second;
+    current_ = id;
+    if (entry.timer)
+    {
+        std::uint64_t expirations(0);
+        if (read(entry.fd, &expirations, sizeof(expirations)) == sizeof(expirations) && expirations > 0)
+        {
+            entry.callback();
+        }
+        if (entry.oneShot && !entry.removed)
+        {
+            epoll_ctl(epollFd_, EPOLL_CTL_DEL, entry.fd, nullptr);
+            entry.removed = true;
+        }
+    }
+    else
+    {
+        entry.fdCallback(events);
+    }
+    current_ = 0;
+
+    if (entry.removed)
+    {
+        erase(id);
+    }
+}
+
+inline timespec TimerFdLoop::toTimespec(std::chrono::nanoseconds value)
+{
+    timespec result = {};
+    if (value.count() > 0)
+    {
+        result.tv_sec = static_cast<time_t>(value.count() / 1000000000);
+        result.tv_nsec = static_cast<long>(value.count() % 1000000000);
+    }
+    return result;
+}
+}
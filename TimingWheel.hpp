@@ -0,0 +1,379 @@
+// MIT License
+//
+// Copyright(c) 2018 Alex Tversky
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#pragma once
+
+#include <cstdint>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace Util
+{
+/**
+ *  \brief TimingWheelNode - intrusive hook of an entry stored in TimingWheel
+ */
+struct TimingWheelNode
+{
+    TimingWheelNode() : prev(nullptr), next(nullptr), expiryTick(0), slot(0)
+    {
+    }
+
+    bool linked() const
+    {
+        return next != nullptr;
+    }
+
+    TimingWheelNode *prev;
+    TimingWheelNode *next;
+    std::uint64_t expiryTick;
+    unsigned slot;
+};
+
+/**
+ *  \brief TimingWheel - hierarchical timing wheel over abstract ticks
+ *
+ *  \details Four levels of 64 slots each cover 2^24 ticks ahead; farther
+ *           entries wait in the last level and are re-cascaded. Insertion and
+ *           removal are O(1); advancing skips empty slots through per-level
+ *           occupancy bitmaps. The wheel owns no memory of its entries and
+ *           is not thread safe: callers serialize access.
+ */
+class TimingWheel
+{
+  public:
+    static const unsigned levelBits = 6;
+    static const unsigned slotsPerLevel = 1u << levelBits;
+    static const unsigned levels = 4;
+
+    TimingWheel();
+    virtual ~TimingWheel();
+
+    void insert(TimingWheelNode &node, std::uint64_t expiryTick);
+    void remove(TimingWheelNode &node);
+
+    template <class F>
+    void advance(std::uint64_t targetTick, F onExpired);
+
+    template <class P, class F>
+    void extractIf(std::uint64_t horizonTick, P predicate, F onExtracted);
+
+    bool nextExpiry(std::uint64_t &tick) const;
+    std::uint64_t currentTick() const;
+    std::uint64_t size() const;
+    bool empty() const;
+
+  private:
+    TimingWheel(const TimingWheel &other) = delete;
+    TimingWheel(const TimingWheel &&other) = delete;
+    TimingWheel &operator=(const TimingWheel &other) = delete;
+    TimingWheel &operator=(const TimingWheel &&other) = delete;
+
+    void place(TimingWheelNode &node);
+    void cascade(unsigned level);
+    std::uint64_t slotStartTick(unsigned level, unsigned index) const;
+
+    static unsigned lowestBit(std::uint64_t mask);
+    static std::uint64_t bitsFrom(std::uint64_t mask, unsigned index);
+
+  private:
+    TimingWheelNode slots_[levels * slotsPerLevel];
+    std::uint64_t occupied_[levels];
+    std::uint64_t current_;
+    std::uint64_t floor_;
+    std::uint64_t size_;
+};
+
+inline TimingWheel::TimingWheel() : current_(0), floor_(0), size_(0)
+{
+    for (unsigned index = 0; index < levels * slotsPerLevel; ++index)
+    {
+        slots_[index].prev = &slots_[index];
+        slots_[index].next = &slots_[index];
+    }
+    for (unsigned level = 0; level < levels; ++level)
+    {
+        occupied_[level] = 0;
+    }
+}
+
+inline TimingWheel::~TimingWheel()
+{
+}
+
+/**
+ * @brief Links a node to expire at the given tick (past ticks expire on next advance)
+ */
+inline void TimingWheel::insert(TimingWheelNode &node, std::uint64_t expiryTick)
+{
+    node.expiryTick = expiryTick;
+    place(node);
+    ++size_;
+}
+
+/**
+ * @brief Unlinks a node; no-op for a node which is not linked
+ */
+inline void TimingWheel::remove(TimingWheelNode &node)
+{
+    if (!node.linked())
+    {
+        return;
+    }
+
+    node.prev->next = node.next;
+    node.next->prev = node.prev;
+    node.prev = nullptr;
+    node.next = nullptr;
+
+    TimingWheelNode &head = slots_[node.slot];
+    if (head.next == &head)
+    {
+        occupied_[node.slot / slotsPerLevel] &= ~(std::uint64_t(1) << (node.slot % slotsPerLevel));
+    }
+    --size_;
+}
+
+/**
+ * @brief Processes all ticks up to and including targetTick
+ *
+ * @param targetTick - the last tick to process
+ * @param onExpired - called with each expired (already unlinked) node; it may
+ *                    insert or remove nodes, already due ones expire next tick
+ */
+template <class F>
+void TimingWheel::advance(std::uint64_t targetTick, F onExpired)
+{
+    while (current_ <= targetTick)
+    {
+        if (size_ == 0)
+        {
+            current_ = targetTick + 1;
+            floor_ = current_;
+            break;
+        }
+
+        const unsigned index(static_cast<unsigned>(current_ % slotsPerLevel));
+        if (index == 0)
+        {
+            unsigned top(1);
+            while (top + 1 < levels &&
+                   ((current_ >> (levelBits * top)) % slotsPerLevel) == 0)
+            {
+                ++top;
+            }
+            for (unsigned level = top; level >= 1; --level)
+            {
+                cascade(level);
+            }
+        }
+
+        // Entries re-inserted as already due go to the next tick, not this slot
+        TimingWheelNode &head = slots_[index];
+        floor_ = current_ + 1;
+        while (head.next != &head)
+        {
+            TimingWheelNode &node = *head.next;
+            remove(node);
+            onExpired(node);
+        }
+        floor_ = current_;
+
+        const std::uint64_t pending(bitsFrom(occupied_[0], index + 1));
+        const std::uint64_t next(current_ - index + (pending ? lowestBit(pending) : slotsPerLevel));
+        current_ = next < targetTick + 1 ? next : targetTick + 1;
+        floor_ = current_;
+    }
+}
+
+/**
+ * @brief Unlinks nodes expiring up to horizonTick which satisfy a predicate
+ *
+ * @param horizonTick - the last tick to look at
+ * @param predicate - decides whether a node is extracted early
+ * @param onExtracted - called with each extracted (already unlinked) node;
+ *                      it must not insert or remove nodes
+ */
+template <class P, class F>
+void TimingWheel::extractIf(std::uint64_t horizonTick, P predicate, F onExtracted)
+{
+    for (unsigned level = 0; level < levels && size_ > 0; ++level)
+    {
+        const unsigned index(static_cast<unsigned>((current_ >> (levelBits * level)) % slotsPerLevel));
+        std::uint64_t pending(occupied_[level]);
+        while (pending)
+        {
+            const unsigned slot(lowestBit(pending));
+            pending &= pending - 1;
+
+            // Lower bound of the slot's ticks; the predicate decides exactly
+            const std::uint64_t start(slot >= index ? slotStartTick(level, slot)
+                                                    : slotStartTick(level, slot + slotsPerLevel));
+            if (start > horizonTick && !(level > 0 && slot == index))
+            {
+                continue;
+            }
+
+            TimingWheelNode &head = slots_[level * slotsPerLevel + slot];
+            TimingWheelNode *node = head.next;
+            while (node != &head)
+            {
+                TimingWheelNode *next = node->next;
+                if (node->expiryTick <= horizonTick && predicate(*node))
+                {
+                    remove(*node);
+                    onExtracted(*node);
+                }
+                node = next;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Returns the earliest tick at which advance() may expire something
+ *
+ * @param [out] tick - a lower bound of the next expiry
+ * @return false - if the wheel is empty
+ */
+inline bool TimingWheel::nextExpiry(std::uint64_t &tick) const
+{
+    if (size_ == 0)
+    {
+        return false;
+    }
+
+    const unsigned index0(static_cast<unsigned>(current_ % slotsPerLevel));
+    const std::uint64_t pending0(bitsFrom(occupied_[0], index0));
+    std::uint64_t best(current_ - index0 + (pending0 ? lowestBit(pending0) : slotsPerLevel));
+
+    // On a block boundary the slots about to cascade are due right away
+    bool aligned(index0 == 0);
+    for (unsigned level = 1; level < levels; ++level)
+    {
+        const unsigned index(static_cast<unsigned>((current_ >> (levelBits * level)) % slotsPerLevel));
+        if (occupied_[level] != 0)
+        {
+            const std::uint64_t ahead(bitsFrom(occupied_[level], aligned ? index : index + 1));
+            const unsigned next(ahead ? lowestBit(ahead) : lowestBit(occupied_[level]) + slotsPerLevel);
+            const std::uint64_t start(slotStartTick(level, next));
+            best = start < best ? start : best;
+        }
+        aligned = aligned && index == 0;
+    }
+
+    tick = best;
+    return true;
+}
+
+inline std::uint64_t TimingWheel::currentTick() const
+{
+    return current_;
+}
+
+inline std::uint64_t TimingWheel::size() const
+{
+    return size_;
+}
+
+inline bool TimingWheel::empty() const
+{
+    return size_ == 0;
+}
+
+inline void TimingWheel::place(TimingWheelNode &node)
+{
+    const std::uint64_t expiry(node.expiryTick < floor_ ? floor_ : node.expiryTick);
+    const std::uint64_t delta(expiry - current_);
+
+    unsigned level(0);
+    while (level + 1 < levels && delta >= (std::uint64_t(1) << (levelBits * (level + 1))))
+    {
+        ++level;
+    }
+
+    // Beyond the horizon: park in the farthest slot, re-placed on cascade
+    std::uint64_t slotTick(expiry);
+    const std::uint64_t horizon(std::uint64_t(1) << (levelBits * levels));
+    if (delta >= horizon)
+    {
+        slotTick = current_ + horizon - 1;
+    }
+
+    const unsigned index(static_cast<unsigned>((slotTick >> (levelBits * level)) % slotsPerLevel));
+    node.slot = level * slotsPerLevel + index;
+
+    TimingWheelNode &head = slots_[node.slot];
+    node.prev = head.prev;
+    node.next = &head;
+    head.prev->next = &node;
+    head.prev = &node;
+    occupied_[level] |= std::uint64_t(1) << index;
+}
+
+inline void TimingWheel::cascade(unsigned level)
+{
+    const unsigned index(static_cast<unsigned>((current_ >> (levelBits * level)) % slotsPerLevel));
+    TimingWheelNode &head = slots_[level * slotsPerLevel + index];
+    if (head.next == &head)
+    {
+        return;
+    }
+
+    // Detach the whole slot first: re-placement may land in this very slot
+    TimingWheelNode *node = head.next;
+    head.prev->next = nullptr;
+    head.prev = &head;
+    head.next = &head;
+    occupied_[level] &= ~(std::uint64_t(1) << index);
+
+    while (node)
+    {
+        TimingWheelNode *next = node->next;
+        place(*node);
+        node = next;
+    }
+}
+
+inline std::uint64_t TimingWheel::slotStartTick(unsigned level, unsigned index) const
+{
+    const unsigned shift(levelBits * (level + 1));
+    const std::uint64_t base(shift < 64 ? (current_ >> shift) << shift : 0);
+    return base + (std::uint64_t(index) << (levelBits * level));
+}
+
+inline unsigned TimingWheel::lowestBit(std::uint64_t mask)
+{
+#if defined(_MSC_VER)
+    unsigned long index(0);
+    _BitScanForward64(&index, mask);
+    return static_cast<unsigned>(index);
+#else
+    return static_cast<unsigned>(__builtin_ctzll(mask));
+#endif
+}
+
+inline std::uint64_t TimingWheel::bitsFrom(std::uint64_t mask, unsigned index)
+{
+    return index >= 64 ? 0 : mask & (~std::uint64_t(0) << index);
+}
+}
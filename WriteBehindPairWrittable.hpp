@@ -0,0 +1,372 @@
+// MIT License
+// 
+// Copyright(c) 2018 Alex Tversky
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#pragma once
+
+#include "Util/IPairWrittable.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace Util
+{
+/**
+ *  \brief WriteBehindPairWrittable - buffers writes to any IPairWrittable
+ *
+ *  \details setValue() only records the value in memory, where repeated
+ *           writes of a key collapse into the latest one. A flusher thread
+ *           hands buffered values to the backend in setValues() batches once
+ *           maxBatch keys are dirty or flushInterval has passed. Reads of
+ *           exact keys see buffered values first; "\*" lookups flush first.
+ *           A failed batch is requeued unless its keys were written again
+ *           meanwhile. flush() and the destructor write everything out.
+ */
+class WriteBehindPairWrittable : public IPairWrittable
+{
+  public:
+    using IPairWrittable::getValue;
+    using IPairWrittable::setValue;
+
+    WriteBehindPairWrittable(IPairWrittable &backend, std::size_t maxBatch = 256,
+                             std::chrono::milliseconds flushInterval = std::chrono::milliseconds(10));
+    virtual ~WriteBehindPairWrittable();
+
+    bool getKeyValue(const std::string &key, std::vector<KeyValuePair> &values) override;
+    bool getValue(const std::string &key, std::vector<std::string> &values) override;
+    bool setValue(const std::string &key, const std::string &value) override;
+    bool setValues(const std::vector<KeyValuePair> &pairs) override;
+    bool getValue(const char *key, std::size_t keyLength, std::string &value) override;
+    bool visitPages(const std::string &key, std::size_t pageSize, const PageVisitor &visitor) override;
+
+    bool flush();
+    std::size_t pending() const;
+    std::uint64_t failedBatches() const;
+
+  private:
+    WriteBehindPairWrittable(const WriteBehindPairWrittable &other) = delete;
+    WriteBehindPairWrittable(const WriteBehindPairWrittable &&other) = delete;
+    WriteBehindPairWrittable &operator=(const WriteBehindPairWrittable &other) = delete;
+    WriteBehindPairWrittable &operator=(const WriteBehindPairWrittable &&other) = delete;
+
+    typedef std::unordered_map<std::string, std::string> Buffer;
+
+    bool buffered(const std::string &key, std::string &value) const;
+    bool writeOut(std::unique_lock<std::mutex> &lock, bool requeue);
+    void work();
+
+  private:
+    IPairWrittable &backend_;
+    const std::size_t maxBatch_;
+    const std::chrono::milliseconds flushInterval_;
+    Buffer dirty_;    // written since the last batch was taken
+    Buffer flushing_; // being written by the flusher, read-only outside the lock
+    std::uint64_t flushRequests_;
+    std::uint64_t flushesDone_;
+    std::uint64_t failedBatches_;
+    bool lastFlushSucceeded_;
+    bool running_;
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::condition_variable flushedCv_;
+    std::thread thread_;
+};
+
+/**
+ * @brief Constructor
+ *
+ * @param backend - a provider to write to, must outlive this object
+ * @param maxBatch - dirty keys which trigger a flush, and the most keys per setValues() call
+ * @param flushInterval - the longest a write stays buffered while the backend accepts it
+ */
+inline WriteBehindPairWrittable::WriteBehindPairWrittable(IPairWrittable &backend, std::size_t maxBatch,
+                                                          std::chrono::milliseconds flushInterval)
+    : backend_(backend), maxBatch_(maxBatch > 0 ? maxBatch : 1), flushInterval_(flushInterval),
+      flushRequests_(0), flushesDone_(0), failedBatches_(0), lastFlushSucceeded_(true), running_(true)
+{
+    thread_ = std::thread(&WriteBehindPairWrittable::work, this);
+}
+
+/**
+ * @brief Destructor, writes out all buffered values first
+ */
+inline WriteBehindPairWrittable::~WriteBehindPairWrittable()
+{
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        running_ = false;
+    }
+    cv_.notify_all();
+    if (thread_.joinable())
+    {
+        thread_.join();
+    }
+}
+
+/**
+ * @brief Flushes, then retrieves key/value pairs from the backend
+ */
+inline bool WriteBehindPairWrittable::getKeyValue(const std::string &key, std::vector<KeyValuePair> &values)
+{
+    if (!key.empty() && '*' != key.back())
+    {
+        std::string value;
+        values.clear();
+        if (buffered(key, value))
+        {
+            if (value.empty())
+            {
+                return false; // a buffered delete
+            }
+            values.push_back(KeyValuePair(key, std::move(value)));
+            return true;
+        }
+    }
+    else
+    {
+        flush();
+    }
+    return backend_.getKeyValue(key, values);
+}
+
+/**
+ * @brief Retrieves value/s by key, a buffered value first
+ *
+ * @param [in] key - a key (can have "\*" notation, which flushes first)
+ * @param [out] values - a single or multiple values
+ * @return true - if key found
+ * @return false - if key not found
+ */
+inline bool WriteBehindPairWrittable::getValue(const std::string &key, std::vector<std::string> &values)
+{
+    if (!key.empty() && '*' != key.back())
+    {
+        values.resize(1);
+        if (buffered(key, values[0]))
+        {
+            if (values[0].empty())
+            {
+                values.clear(); // a buffered delete
+            }
+            return !values.empty();
+        }
+    }
+    else
+    {
+        flush();
+    }
+    return backend_.getValue(key, values);
+}
+
+inline bool WriteBehindPairWrittable::getValue(const char *key, std::size_t keyLength, std::string &value)
+{
+    if (buffered(std::string(key, keyLength), value))
+    {
+        return !value.empty(); // empty: a buffered delete
+    }
+    return backend_.getValue(key, keyLength, value);
+}
+
+/**
+ * @brief Streams key/value pairs from the backend, flushing first for "\*" keys
+ */
+inline bool WriteBehindPairWrittable::visitPages(const std::string &key, std::size_t pageSize,
+                                                 const PageVisitor &visitor)
+{
+    if (key.empty() || '*' != key.back())
+    {
+        return IPairWrittable::visitPages(key, pageSize, visitor); // sees buffered values
+    }
+    flush();
+    return backend_.visitPages(key, pageSize, visitor);
+}
+
+/**
+ * @brief Buffers a value, collapsing it with earlier unflushed writes of the key
+ *
+ * @return true - always, backend failures are retried and counted by failedBatches()
+ */
+inline bool WriteBehindPairWrittable::setValue(const std::string &key, const std::string &value)
+{
+    bool full(false);
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        dirty_[key].assign(value);
+        full = dirty_.size() >= maxBatch_;
+    }
+    if (full)
+    {
+        cv_.notify_one();
+    }
+    return true;
+}
+
+inline bool WriteBehindPairWrittable::setValues(const std::vector<KeyValuePair> &pairs)
+{
+    bool full(false);
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        for (const KeyValuePair &pair : pairs)
+        {
+            dirty_[pair.key].assign(pair.value);
+        }
+        full = dirty_.size() >= maxBatch_;
+    }
+    if (full)
+    {
+        cv_.notify_one();
+    }
+    return true;
+}
+
+/**
+ * @brief Writes out all values buffered so far and waits for it
+ *
+ * @return true - if the backend accepted them, false - otherwise (they stay buffered)
+ */
+inline bool WriteBehindPairWrittable::flush()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    const std::uint64_t request(++flushRequests_);
+    cv_.notify_one();
+    flushedCv_.wait(lock, [this, request]() { return flushesDone_ >= request || !running_; });
+    return lastFlushSucceeded_;
+}
+
+/**
+ * @brief Returns number of keys buffered or being written
+ */
+inline std::size_t WriteBehindPairWrittable::pending() const
+{
+    std::lock_guard<std::mutex> guard(mutex_);
+    return dirty_.size() + flushing_.size();
+}
+
+/**
+ * @brief Returns number of setValues() calls the backend failed
+ */
+inline std::uint64_t WriteBehindPairWrittable::failedBatches() const
+{
+    std::lock_guard<std::mutex> guard(mutex_);
+    return failedBatches_;
+}
+
+/**
+ * @brief Retrieves an unflushed value, empty for a buffered delete
+ *
+ * @return true - if the key is buffered, its backend value is stale
+ */
+inline bool WriteBehindPairWrittable::buffered(const std::string &key, std::string &value) const
+{
+    std::lock_guard<std::mutex> guard(mutex_);
+    Buffer::const_iterator found(dirty_.find(key));
+    if (found == dirty_.end())
+    {
+        found = flushing_.find(key);
+        if (found == flushing_.end())
+        {
+            return false;
+        }
+    }
+    value.assign(found->second);
+    return true;
+}
+
+/**
+ * @brief Writes the dirty buffer out in batches, the lock is released meanwhile
+ *
+ * @param requeue - whether a failed batch goes back into the buffer
+ * @return true - if all batches succeeded
+ */
+inline bool WriteBehindPairWrittable::writeOut(std::unique_lock<std::mutex> &lock, bool requeue)
+{
+    flushing_.swap(dirty_);
+    lock.unlock();
+
+    bool status(true);
+    std::vector<KeyValuePair> batch;
+    std::vector<KeyValuePair> failed;
+    Buffer::const_iterator next(flushing_.begin());
+    while (next != flushing_.end())
+    {
+        batch.clear();
+        for (; next != flushing_.end() && batch.size() < maxBatch_; ++next)
+        {
+            batch.push_back(KeyValuePair(next->first, next->second));
+        }
+        const bool written(batch.size() == 1 ? backend_.setValue(batch[0].key, batch[0].value)
+                                             : backend_.setValues(batch));
+        if (!written)
+        {
+            status = false;
+            failed.insert(failed.end(), batch.begin(), batch.end());
+        }
+    }
+
+    lock.lock();
+    if (!status)
+    {
+        ++failedBatches_;
+    }
+    for (KeyValuePair &pair : failed)
+    {
+        if (requeue && dirty_.find(pair.key) == dirty_.end())
+        {
+            dirty_[pair.key].swap(pair.value); // newer writes win
+        }
+    }
+    flushing_.clear();
+    return status;
+}
+
+inline void WriteBehindPairWrittable::work()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (running_)
+    {
+        cv_.wait_for(lock, flushInterval_, [this]() {
+            return !running_ || dirty_.size() >= maxBatch_ || flushRequests_ > flushesDone_;
+        });
+        if (!running_)
+        {
+            break;
+        }
+
+        const std::uint64_t requests(flushRequests_);
+        const bool status(dirty_.empty() ? true : writeOut(lock, true));
+        if (requests > flushesDone_)
+        {
+            lastFlushSucceeded_ = status;
+            flushesDone_ = requests;
+            flushedCv_.notify_all();
+        }
+    }
+
+    // Shutdown: one last attempt, nothing left to retry with
+    lastFlushSucceeded_ = dirty_.empty() ? true : writeOut(lock, false);
+    flushesDone_ = flushRequests_;
+    flushedCv_.notify_all();
+}
+}